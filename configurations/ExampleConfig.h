@@ -10,8 +10,8 @@
 #define LD "clang"
 
 #define LCONFIG , "-DLAYE_USE_LINUX"
-#define CFLAGS "-Iinclude", "-std=c23", "-Wall", "-Werror", "-Werror=return-type", "-pedantic", "-pedantic-errors", "-ggdb", "-fsanitize=address" LCONFIG
-#define LDFLAGS "-ggdb", "-fsanitize=address"
+#define CFLAGS "-Iinclude", "-std=c23", "-Wall", "-Werror", "-Werror=return-type", "-pedantic", "-pedantic-errors", "-ggdb", "-fsanitize=address", "-pthread" LCONFIG
+#define LDFLAGS "-ggdb", "-fsanitize=address", "-pthread"
 
 #define EXE_EXT ""
 #define LIB_EXT ".a"
@@ -17,8 +17,9 @@ extern "C" {
 #    define CHOIR_API extern
 #endif // CHOIR_BUILD_DLL
 
+/// Assert 'Cond', reporting 'Location' within 'Source' if it does not hold.
 #define ch_asserts(Diag, Cond, Source, Location, Msg) \
-    k_assertsf((Diag), (Cond), ((k_diag_source){ .name = (Source)->name, .text = (Source)->text, .use_byte_offset = true, .byte_offset = (Location) }), Msg)
+    k_assertsf((Diag), (Cond), ((k_diag_source){ .name = (Source)->name, .text = (Source)->text, .use_byte_offset = true, .byte_offset = (Location) - (Source)->location }), Msg)
 
 ///===--------------------------------------===///
 /// Data types.
@@ -48,34 +49,111 @@ typedef isize_t ch_size_t;
 /// @note In a more "type-oriented" language, this would be represented instead as an integer power and converted to the power-of-two when converted to its integer representation at the last moment.
 typedef int16_t ch_align_t;
 
+/// @brief The width tab stops are at when a context is not told otherwise.
+#define CH_DEFAULT_TAB_WIDTH 8
+
+/// @brief A location in the text of any source or macro expansion of a context.
+/// Every source and expansion a context knows of is handed a slice of one 32-bit location space by its source manager, so a location alone says which source it is in.
+/// Decode one with @c ch_context_decode_location.
+typedef uint32_t ch_location;
+
+/// @brief The location of nothing; no source or expansion is ever given it.
+#define CH_LOCATION_NONE 0
+
 /// @brief Source text from any language or input source.
 typedef struct ch_source {
     /// @brief The name of this source, usually a canonical file path for a source file or an angle-bracketted "<compiler-internal>"" name.
     k_string_view name;
     /// @brief The full text of this source.
     k_string_view text;
+    /// @brief The location of the first byte of this source's text, or @c CH_LOCATION_NONE if it has not been added to a context yet.
+    /// The byte at offset N of the text is at location + N.
+    /// @ref ch_context_add_source
+    ch_location location;
+    /// @brief The offset of the first byte of every line of the text, in increasing order.
+    /// Built the first time a line or column in this source is asked for, and empty until then.
+    /// @ref ch_source_get_line_column
+    struct {
+        K_DA_DECLARE_INLINE(uint32_t);
+    } line_starts;
     /// @brief True if this source represents a "system" file and should be treated more lax by the language semantics.
     /// Used primarily for system C headers, which may make liberal use of extensions or incompatible features.
     bool is_system_source : 1;
+    /// @brief True once the text has been checked for ill-formed UTF-8, so that however often the source is lexed, its encoding errors are reported once.
+    bool is_encoding_checked : 1;
 } ch_source;
 
-/// @brief A 0-based byte location within the text of a source.
-typedef isize_t ch_location;
-
-/// @brief A 0-based byte range within the text of the referenced source.
+/// @brief A range of locations within the text of one source or macro expansion.
 /// The byte length of this range is given by end - begin.
 typedef struct ch_range {
-    /// @brief The source this range applies to.
-    ch_source* source;
-    /// @brief The beginning byte offset of this range.
+    /// @brief The location of the first byte of this range.
     ch_location begin;
-    /// @brief The ending byte offset of this range.
+    /// @brief The location just past the last byte of this range.
     ch_location end;
 } ch_range;
 
+/// @brief The slice of a context's location space given to one source or macro expansion.
+/// @ref ch_source_manager
+typedef struct ch_source_entry {
+    /// @brief The first location in this slice.
+    ch_location location;
+    /// @brief The number of locations in this slice.
+    uint32_t size;
+    /// @brief The source whose text this slice covers, or nullptr if this is a macro expansion.
+    ch_source* source;
+    /// @brief For a macro expansion, the location its first byte is spelled at; the rest follow on from it.
+    ch_location spelling_location;
+    /// @brief For a macro expansion, the range of the macro use it replaces.
+    ch_range expansion_range;
+} ch_source_entry;
+
+/// @brief Hands out the locations of a context, and maps them back to what they are in.
+typedef struct ch_source_manager {
+    /// @brief Every slice handed out so far, in increasing order of location.
+    struct {
+        K_DA_DECLARE_INLINE(ch_source_entry);
+    } entries;
+    /// @brief The first location not handed out yet.
+    ch_location next_location;
+} ch_source_manager;
+
+/// @brief A location decoded back to the source it is spelled in.
+/// @ref ch_context_decode_location
+typedef struct ch_decoded_location {
+    /// @brief The source the location is spelled in, or nullptr if it is not a location of this context.
+    ch_source* source;
+    /// @brief The 0-based byte offset of the location into the text of @c source.
+    isize_t offset;
+    /// @brief The 1-based line of the location.
+    isize_t line;
+    /// @brief The 1-based column of the location, counting each codepoint as one column and tabs up to the next tab stop.
+    isize_t column;
+    /// @brief The range of the macro use the location was expanded from if it is in an expansion, otherwise empty.
+    ch_range expansion_range;
+} ch_decoded_location;
+
 typedef struct ch_context {
     k_diag* diag;
     k_arena* string_arena;
+    /// @brief The arena tokens, syntax nodes and buffers of them are allocated from.
+    k_arena* node_arena;
+    /// @brief A pool over @c node_arena for tokens, syntax nodes and buffers of them which are discarded mid-pipeline, such as macro expansion temporaries.
+    /// Storage returned to the pool is recycled instead of growing the arena without bound.
+    /// Nothing uses it yet: it is here so the preprocessor, the first pipeline stage to discard tokens, is written against it from the start.
+    k_pool node_pool;
+    /// @brief Every identifier spelling seen in this context, stored once in @c string_arena.
+    /// Compare spellings by their @c k_intern_id rather than by their text.
+    k_intern_table intern_table;
+    /// @brief The sources and macro expansions of this context, each with its own slice of locations.
+    ch_source_manager source_manager;
+    /// @brief The number of columns between tab stops, for reporting columns.
+    isize_t tab_width;
+    /// @brief The C dialects C sources of this context are lexed as, as Laye @c ly_token_key flags, or zero until one is set.
+    /// @ref ly_context_set_c_dialect
+    uint32_t c_dialect_keys;
+    /// @brief The keywords of @c c_dialect_keys, or @c nullptr for the C23 keywords until a dialect is set.
+    /// Built once when the dialect is set and only read after that, so every C lexer of this context shares it, including workers lexing for it on other threads.
+    const struct ly_keyword_table* c_keyword_table;
 } ch_context;
 
 ///===--------------------------------------===///
@@ -97,7 +175,40 @@ CHOIR_API ch_align_t ch_align_for_bytes(ch_size_t bytes);
 /// Context API.
 ///===--------------------------------------===///
 
-CHOIR_API void ch_context_init(ch_context* context, k_diag* diag, k_arena* string_arena);
+CHOIR_API void ch_context_init(ch_context* context, k_diag* diag, k_arena* string_arena, k_arena* node_arena);
+
+/// @brief Write a per-arena breakdown of the memory used by this context to @c stream.
+/// Covers the string and node arenas, plus the diagnostic arena if it is a separate one.
+/// Tag the arenas with @c k_arena_set_tag beforehand to tell them apart in the report.
+CHOIR_API void ch_context_print_memory_report(ch_context* context, FILE* stream);
+
+///===--------------------------------------===///
+/// Source manager API.
+///===--------------------------------------===///
+
+/// @brief Give @c source a slice of this context's locations, one per byte of its text and one for its end, and returns the first.
+/// A source can only be added to one context, once.
+CHOIR_API ch_location ch_context_add_source(ch_context* context, ch_source* source);
+
+/// @brief Give a macro expansion of @c length bytes a slice of this context's locations and returns the first.
+/// Its bytes are spelled at @c spelling_location onwards, and replace the macro use in @c expansion_range.
+CHOIR_API ch_location ch_context_add_expansion(ch_context* context, ch_location spelling_location, ch_range expansion_range, isize_t length);
+
+/// @brief Returns the location of the byte at @c offset into the text of @c source, which must have been added to a context.
+CHOIR_API ch_location ch_source_get_location(const ch_source* source, isize_t offset);
+
+/// @brief Returns the source whose text @c location is in, or nullptr if it is in a macro expansion or not a location of this context.
+/// Unlike @c ch_context_decode_location this never needs the line table, so it is cheap enough to call per token.
+CHOIR_API ch_source* ch_context_get_source(ch_context* context, ch_location location);
+
+/// @brief Compute the 1-based line and column of the byte at @c offset into the text of @c source.
+/// Columns count each codepoint as one and advance tabs to the next multiple of the context's tab width.
+/// The first call for a source builds its line table in the context's string arena; every call after that is a binary search of it.
+CHOIR_API void ch_source_get_line_column(ch_context* context, ch_source* source, isize_t offset, isize_t* out_line, isize_t* out_column);
+
+/// @brief Decode @c location back to the source it is spelled in, its offset into that source's text, and its line and column.
+/// Locations in macro expansions are followed back to where they are spelled.
+CHOIR_API ch_decoded_location ch_context_decode_location(ch_context* context, ch_location location);
 
 #if defined(__cplusplus)
 }
@@ -43,6 +43,19 @@ extern "C" {
 #    define K_CLANG 1
 #endif // __clang__
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#    define K_SSE2 1
+#endif // SSE2
+
+#ifdef __AVX2__
+#    define K_AVX2 1
+#endif // __AVX2__
+
+/// Labels as values ("computed goto"), for dispatch tables in hot loops; code using them needs a switch fallback for other compilers.
+#if defined(__GNUC__) || defined(__clang__)
+#    define K_COMPUTED_GOTO 1
+#endif // __GNUC__ || __clang__
+
 ///===--------------------------------------===///
 /// "Fancy" macros.
 ///===--------------------------------------===///
@@ -89,6 +102,16 @@ extern "C" {
 #    define K_DA_INIT_CAP 256
 #endif
 
+#ifndef K_DA_GROWTH_NUMERATOR
+/// @brief The numerator of the factor a dynamic array's capacity is multiplied by when it has to grow.
+#    define K_DA_GROWTH_NUMERATOR 2
+#endif
+
+#ifndef K_DA_GROWTH_DENOMINATOR
+/// @brief The denominator of the factor a dynamic array's capacity is multiplied by when it has to grow.
+#    define K_DA_GROWTH_DENOMINATOR 1
+#endif
+
 /// Declare the required fields of a dynamic array of the given element type.
 #define K_DA_DECLARE_INLINE(ElementType) \
     k_arena* arena;                      \
@@ -96,65 +119,84 @@ extern "C" {
     isize_t capacity;                    \
     isize_t count
 
-// Push an item to a dynamic array.
-#define k_da_push(DynArr, Item)                                                                    \
-    do {                                                                                           \
-        if ((DynArr)->count >= (DynArr)->capacity) {                                               \
-            (DynArr)->capacity = (DynArr)->capacity == 0 ? K_DA_INIT_CAP : (DynArr)->capacity * 2; \
-            size_t new_size = k_cast(size_t)(DynArr)->capacity * sizeof(*(DynArr)->data);          \
-            if ((DynArr)->arena == nullptr) {                                                      \
-                (DynArr)->data = realloc((DynArr)->data, new_size);                                \
-                memset((DynArr)->data + (DynArr)->count, 0, (DynArr)->capacity - (DynArr)->count); \
-            } else {                                                                               \
-                void* old_data = (DynArr)->data;                                                   \
-                (DynArr)->data = k_arena_alloc((DynArr)->arena, new_size);                         \
-                memcpy((DynArr)->data, old_data, k_cast(size_t)(DynArr)->count);                   \
-            }                                                                                      \
-            assert((DynArr)->data != nullptr && "Buy more RAM lol");                               \
-        }                                                                                          \
-        (DynArr)->data[(DynArr)->count++] = (Item);                                                \
+/// The size in bytes of one element of a dynamic array.
+#define K_DA_ELEMENT_SIZE(DynArr) sizeof(*(DynArr)->data)
+
+// Ensure a dynamic array can hold at least MinCapacity elements, growing geometrically if it can't.
+#define k_da_reserve(DynArr, MinCapacity)                                                                                                                       \
+    do {                                                                                                                                                        \
+        if ((DynArr)->capacity < (MinCapacity)) {                                                                                                               \
+            (DynArr)->data = k_da_grow((DynArr)->arena, (DynArr)->data, (DynArr)->count, &(DynArr)->capacity, K_DA_ELEMENT_SIZE(DynArr), (MinCapacity), false); \
+        }                                                                                                                                                       \
     } while (0)
 
-#define k_da_free(DynArr)                 \
-    do {                                  \
-        if ((DynArr)->arena == nullptr) { \
-            free((DynArr)->data);         \
-            (DynArr)->data = nullptr;     \
-            (DynArr)->capacity = 0;       \
-        }                                 \
-        (DynArr)->count = 0;              \
+// Ensure a dynamic array can hold at least Capacity elements, growing to exactly that capacity if it can't.
+// Use this when the final size is known up front, e.g. from a size estimate of the input.
+#define k_da_reserve_exact(DynArr, Capacity)                                                                                                                \
+    do {                                                                                                                                                    \
+        if ((DynArr)->capacity < (Capacity)) {                                                                                                              \
+            (DynArr)->data = k_da_grow((DynArr)->arena, (DynArr)->data, (DynArr)->count, &(DynArr)->capacity, K_DA_ELEMENT_SIZE(DynArr), (Capacity), true); \
+        }                                                                                                                                                   \
     } while (0)
 
-#define k_da_ensure_capacity(DynArr, MinCapacity)                                                  \
-    do {                                                                                           \
-        if ((DynArr)->capacity < (MinCapacity)) {                                                  \
-            if ((DynArr)->capacity == 0) {                                                         \
-                (DynArr)->capacity = K_DA_INIT_CAP;                                                \
-            }                                                                                      \
-            while ((MinCapacity) > (DynArr)->capacity) {                                           \
-                (DynArr)->capacity *= 2;                                                           \
-            }                                                                                      \
-            size_t new_size = k_cast(size_t)(DynArr)->capacity * sizeof(*(DynArr)->data);          \
-            if ((DynArr)->arena == nullptr) {                                                      \
-                (DynArr)->data = realloc((DynArr)->data, new_size);                                \
-                memset((DynArr)->data + (DynArr)->count, 0, (DynArr)->capacity - (DynArr)->count); \
-            } else {                                                                               \
-                void* old_data = (DynArr)->data;                                                   \
-                (DynArr)->data = k_arena_alloc((DynArr)->arena, new_size);                         \
-                memcpy((DynArr)->data, old_data, k_cast(size_t)(DynArr)->count);                   \
-            }                                                                                      \
-            assert((DynArr)->data != NULL && "Buy more RAM lol");                                  \
-        }                                                                                          \
+#define k_da_ensure_capacity(DynArr, MinCapacity) k_da_reserve((DynArr), (MinCapacity))
+
+// Push an item to a dynamic array.
+#define k_da_push(DynArr, Item)                          \
+    do {                                                 \
+        if ((DynArr)->count >= (DynArr)->capacity) {     \
+            k_da_reserve((DynArr), (DynArr)->count + 1); \
+        }                                                \
+        (DynArr)->data[(DynArr)->count++] = (Item);      \
     } while (0)
 
 // Push several items to a dynamic array.
 #define k_da_push_many(DynArr, NewItems, NewItemsCount)                                                                \
     do {                                                                                                               \
-        k_da_ensure_capacity((DynArr), (DynArr)->count + (NewItemsCount));                                             \
+        k_da_reserve((DynArr), (DynArr)->count + (NewItemsCount));                                                     \
         memcpy((DynArr)->data + (DynArr)->count, (NewItems), k_cast(size_t)(NewItemsCount) * sizeof(*(DynArr)->data)); \
         (DynArr)->count += (NewItemsCount);                                                                            \
     } while (0)
 
+// Push every item of another dynamic array of the same element type to a dynamic array.
+#define k_da_extend(DynArr, OtherDynArr) k_da_push_many((DynArr), (OtherDynArr)->data, (OtherDynArr)->count)
+
+// Insert an item into a dynamic array before the item at Index, shifting later items up by one.
+#define k_da_insert(DynArr, Index, Item)                                                                                                                     \
+    do {                                                                                                                                                     \
+        isize_t insert_index = (Index);                                                                                                                      \
+        assert(insert_index >= 0 && insert_index <= (DynArr)->count);                                                                                        \
+        k_da_reserve((DynArr), (DynArr)->count + 1);                                                                                                         \
+        memmove((DynArr)->data + insert_index + 1, (DynArr)->data + insert_index, k_cast(size_t)((DynArr)->count - insert_index) * sizeof(*(DynArr)->data)); \
+        (DynArr)->data[insert_index] = (Item);                                                                                                               \
+        (DynArr)->count++;                                                                                                                                   \
+    } while (0)
+
+// Remove and return the last item of a non-empty dynamic array.
+#define k_da_pop(DynArr) (assert((DynArr)->count > 0), (DynArr)->data[--(DynArr)->count])
+
+// Shorten a dynamic array to NewCount items, keeping its capacity.
+#define k_da_truncate(DynArr, NewCount)                           \
+    do {                                                          \
+        assert((NewCount) >= 0 && (NewCount) <= (DynArr)->count); \
+        (DynArr)->count = (NewCount);                             \
+    } while (0)
+
+// Release any capacity a dynamic array has beyond its count.
+// Arena-backed arrays keep their storage, since arena memory is only ever reclaimed wholesale.
+#define k_da_shrink_to_fit(DynArr) \
+    ((DynArr)->data = k_da_shrink((DynArr)->arena, (DynArr)->data, (DynArr)->count, &(DynArr)->capacity, K_DA_ELEMENT_SIZE(DynArr)))
+
+#define k_da_free(DynArr)                 \
+    do {                                  \
+        if ((DynArr)->arena == nullptr) { \
+            free((DynArr)->data);         \
+            (DynArr)->data = nullptr;     \
+            (DynArr)->capacity = 0;       \
+        }                                 \
+        (DynArr)->count = 0;              \
+    } while (0)
+
 #define K_STR_FMT       "%.*s"
 #define K_STR_EXPAND(S) k_cast(int)(S).count, (S).data
 
@@ -192,27 +234,135 @@ typedef enum k_diag_level {
     K_DIAG_FATAL,
 } k_diag_level;
 
+/// @brief U+FFFD, which stands in for ill-formed sequences when decoding leniently.
+#define K_UNICODE_REPLACEMENT_CHARACTER 0xFFFD
+
 typedef enum k_unicode_decode_result {
     K_UNICODE_SUCCESS = 0,
     K_UNICODE_END_OF_DATA,
     K_UNICODE_OUT_OF_RANGE,
     K_UNICODE_INVALID_START_BYTE,
     K_UNICODE_INVALID_CONTINUE_BYTE,
+    /// @brief The sequence encodes its codepoint in more bytes than necessary.
+    K_UNICODE_OVERLONG_ENCODING,
+    /// @brief The sequence encodes a UTF-16 surrogate or a value past U+10FFFF, neither of which is a valid codepoint.
+    K_UNICODE_INVALID_CODEPOINT,
 } k_unicode_decode_result;
 
 /// @brief A single block in an arena.
 /// You should not be using this type directly.
 typedef struct k_arena_block {
     char* data;
+    /// @brief The size of this block in bytes; larger than the usual block size only for a block made to fit one big allocation.
+    isize_t capacity;
+    /// @brief The number of bytes used in this block.
+    /// Only accurate for blocks the arena has moved past; the current block's usage is tracked by the arena's cursor instead.
     isize_t count_allocated;
 } k_arena_block;
 
+/// @brief Options for arenas backed by a virtual memory reservation.
+/// @ref k_arena_init_virtual
+typedef enum k_arena_flags {
+    K_ARENA_FLAGS_NONE = 0,
+    /// @brief Back the reservation with explicit huge pages (@c MAP_HUGETLB) if the system's huge page pool can hold all of it.
+    /// The whole reservation is taken from the pool up front, so keep it modest.
+    /// Falls back to regular pages with a transparent huge page hint otherwise.
+    K_ARENA_HUGE_PAGES = 1 << 0,
+    /// @brief Hint that the system should back the reservation with transparent huge pages.
+    K_ARENA_TRANSPARENT_HUGE_PAGES = 1 << 1,
+} k_arena_flags;
+
+#ifndef K_ARENA_STATS
+/// @brief Set to 0 to compile out the allocation statistics every arena keeps.
+#    define K_ARENA_STATS 1
+#endif
+
+/// @brief Allocation statistics of an arena.
+/// Counters marked cumulative only ever grow; the rest describe the arena as it is right now.
+/// @ref k_arena_get_stats
+typedef struct k_arena_stats {
+    /// @brief The number of allocations made. Cumulative.
+    isize_t allocation_count;
+    /// @brief The number of bytes asked for by allocations. Cumulative.
+    isize_t bytes_requested;
+    /// @brief The number of bytes skipped to align allocations. Cumulative.
+    isize_t bytes_padding;
+    /// @brief The number of bytes left unused at the end of blocks when an allocation did not fit and moved on to the next block. Cumulative.
+    isize_t bytes_tail_waste;
+    /// @brief The number of bytes currently allocated, including alignment padding.
+    isize_t bytes_in_use;
+    /// @brief The highest @c bytes_in_use has been.
+    isize_t bytes_peak;
+    /// @brief The number of heap blocks the arena holds. Always zero for arenas backed by a virtual memory reservation.
+    isize_t block_count;
+    /// @brief The number of bytes the arena holds on to: heap blocks, or committed pages of a virtual memory reservation.
+    isize_t bytes_committed;
+} k_arena_stats;
+
 /// @brief A memory arena for controling memory scopes and lifetimes.
+/// By default an arena is a chain of fixed-size heap blocks, but it can instead be backed by a single contiguous virtual memory reservation; see @c k_arena_init_virtual.
 typedef struct k_arena k_arena;
 struct k_arena {
+    /// @brief The heap blocks of this arena. Always empty for arenas backed by a virtual memory reservation.
     K_DA_DECLARE_INLINE(k_arena_block);
+    /// @brief The index of the block currently being allocated from.
+    /// Blocks after this one are only present after a rewind, and are reused before any new block is allocated.
+    isize_t current_block;
+    /// @brief The next free byte in the current block.
+    char* cursor;
+    /// @brief One past the last usable byte in the current block.
+    /// Allocation is a bump of @c cursor so long as the result does not pass this limit.
+    /// For arenas backed by a virtual memory reservation this is the end of the committed pages.
+    char* limit;
+    /// @brief The start of the virtual memory reservation backing this arena, or null if it is backed by heap blocks.
+    char* reserve_base;
+    /// @brief One past the end of the virtual memory reservation backing this arena.
+    char* reserve_limit;
+    /// @brief The number of bytes committed at a time when the reservation needs to grow.
+    isize_t commit_granularity;
+    /// @brief A short name for what this arena is used for, shown in memory reports.
+    /// @ref k_arena_set_tag
+    const char* tag;
+    /// @brief Allocation statistics, only kept up to date if @c K_ARENA_STATS is enabled.
+    /// Use @c k_arena_get_stats rather than reading this directly.
+    k_arena_stats stats;
 };
 
+/// @brief A saved high-water point in an arena, which the arena can later be rewound to.
+/// @ref k_arena_mark
+/// @ref k_arena_rewind
+typedef struct k_arena_checkpoint {
+    isize_t block_index;
+    isize_t block_offset;
+    /// @brief The arena's @c bytes_in_use statistic at the time of the checkpoint, restored on rewind.
+    isize_t bytes_in_use;
+} k_arena_checkpoint;
+
+/// @brief The number of distinct size classes a @c k_pool keeps free lists for.
+/// Sizes up to 256 bytes are grouped in steps of 16 bytes, and larger sizes in powers of two up to @c K_POOL_MAX_SIZE.
+#define K_POOL_SIZE_CLASS_COUNT 24
+
+/// @brief The largest allocation a @c k_pool recycles.
+/// Larger allocations are passed straight through to the pool's arena and are not recycled when freed.
+#define K_POOL_MAX_SIZE (64 * 1024)
+
+/// @brief A freed object in a @c k_pool, threaded onto the free list for its size class.
+/// You should not be using this type directly.
+typedef struct k_pool_free_object {
+    struct k_pool_free_object* next;
+} k_pool_free_object;
+
+/// @brief An allocator for objects of uniform sizes, such as tokens and syntax nodes, built on top of an arena.
+/// Freed objects are kept on a free list per size class and handed out again by the next allocation of that class, so both operations are constant time.
+/// Memory is never returned to the arena; the pool only bounds how much of it is used by short-lived objects.
+/// Its first user will be the preprocessor's macro expansion buffers, through @c ch_context's node pool.
+typedef struct k_pool {
+    /// @brief The arena new objects are allocated from when their free list is empty.
+    k_arena* arena;
+    /// @brief The heads of the free lists, one per size class.
+    k_pool_free_object* free_lists[K_POOL_SIZE_CLASS_COUNT];
+} k_pool;
+
 /// @brief An immutable view into underlying, non-owned string data.
 typedef struct k_string_view {
     const char* data;
@@ -224,6 +374,34 @@ typedef struct k_string {
     K_DA_DECLARE_INLINE(char);
 } k_string;
 
+/// @brief A handle to a string in a @c k_intern_table.
+/// Two handles from the same table are equal exactly when their spellings are, so comparing strings is comparing integers.
+/// @ref k_intern
+typedef uint32_t k_intern_id;
+
+/// @brief The handle of no string at all, and of the empty string; @c k_intern returns it for nothing else.
+#define K_INTERN_ID_NONE 0
+
+/// @brief A string stored in an intern table.
+/// You should not be using this type directly.
+typedef struct k_intern_entry {
+    k_string_view text;
+    uint64_t hash;
+} k_intern_entry;
+
+/// @brief A table storing each distinct string once and handing out a stable @c k_intern_id for it.
+/// Spellings and the table itself are allocated from an arena, so interned strings live as long as it does.
+typedef struct k_intern_table {
+    /// @brief Every interned string, indexed by its handle. Entry 0 is reserved for @c K_INTERN_ID_NONE.
+    struct {
+        K_DA_DECLARE_INLINE(k_intern_entry);
+    } entries;
+    /// @brief An open-addressed hash table of handles; each slot holds the upper half of the string's hash above its handle, or 0 if empty.
+    uint64_t* slots;
+    /// @brief The number of slots, always a power of two.
+    isize_t slot_count;
+} k_intern_table;
+
 /// @brief Optional source information for reporting diagnostics within files.
 /// None of these fields are required; if empty or zero, they should be ignored when generating the diagnostic output.
 /// This means, for example, a binary file could point to a byte_offset without providing any text to display, and the diagnostic callbacks should handle that correctly.
@@ -310,6 +488,44 @@ typedef struct k_diag_formatted_state {
     bool has_emitted_diag_group;
 } k_diag_formatted_state;
 
+/// @brief A fixed set of worker threads which run batches of tasks, stealing work from each other to stay busy.
+/// @ref k_thread_pool_create
+typedef struct k_thread_pool k_thread_pool;
+
+/// @brief The type of a task run by a thread pool.
+/// Called once for each task index in a run, on whichever worker gets to it; @c worker_index is in [0, worker count) and identifies the calling worker for the duration of the call.
+typedef void (*k_task_callback)(void* userdata, isize_t task_index, isize_t worker_index);
+
+///===--------------------------------------===///
+/// Bit manipulation API.
+///===--------------------------------------===///
+
+#if defined(K_MSVC)
+#    include <intrin.h>
+#endif // K_MSVC
+
+/// @brief Returns the number of trailing zero bits in @c value, which must not be zero.
+/// Used with SIMD compare masks to find the first matching byte of a chunk, so it is inline to compile down to a single instruction there.
+static inline int k_count_trailing_zeros(uint32_t value) {
+    assert(value != 0);
+#if defined(K_MSVC)
+    unsigned long index;
+    _BitScanForward(&index, value);
+    return k_cast(int) index;
+#else  // !K_MSVC
+    return __builtin_ctz(value);
+#endif // K_MSVC
+}
+
+/// @brief Returns the number of bits set in @c value.
+static inline int k_count_ones(uint32_t value) {
+#if defined(K_MSVC)
+    return k_cast(int) __popcnt(value);
+#else  // !K_MSVC
+    return __builtin_popcount(value);
+#endif // K_MSVC
+}
+
 ///===--------------------------------------===///
 /// Arenas API.
 ///===--------------------------------------===///
@@ -318,6 +534,16 @@ typedef struct k_diag_formatted_state {
 /// @param arena The arena to initialize.
 void k_arena_init(k_arena* arena);
 
+/// @brief Initialize this allocator to be backed by a single contiguous reservation of @c reserve_size bytes of address space.
+/// Pages are committed on demand as the arena grows, so reserving far more than will be used is cheap.
+/// Such an arena has no limit on the size of a single allocation other than the reservation itself, and @c k_arena_trim returns unused pages to the system.
+/// Allocating past the end of the reservation is a fatal error which aborts in every build, so size it for the largest input to be handled.
+/// Only supported on Linux; elsewhere, or if the reservation fails, this returns false and leaves the arena as if by @c k_arena_init.
+/// @param arena The arena to initialize.
+/// @param reserve_size The number of bytes of address space to reserve.
+/// @param flags Options for the pages backing the reservation.
+bool k_arena_init_virtual(k_arena* arena, size_t reserve_size, k_arena_flags flags);
+
 /// @brief De-initialize this allocator, freeing all of its associated memory.
 /// @param arena The arena to de-initialize.
 void k_arena_deinit(k_arena* arena);
@@ -326,19 +552,159 @@ void k_arena_deinit(k_arena* arena);
 /// The memory will be zeroed and aligned to K_ARENA_ALIGN bytes.
 void* k_arena_alloc(k_arena* arena, size_t size);
 
+/// @brief Allocate @c size number of bytes in this arena without zeroing them.
+/// The memory will be aligned to K_ARENA_ALIGN bytes.
+/// Prefer this over @c k_arena_alloc when every byte is about to be overwritten anyway.
+void* k_arena_alloc_uninit(k_arena* arena, size_t size);
+
+/// @brief Allocate @c size number of bytes in this arena, aligned to @c align bytes, without zeroing them.
+/// A @c size of zero is allowed and returns a valid, aligned pointer which must not be dereferenced.
+/// @param align The required alignment, which must be a power of two. Character data can pass 1 to avoid padding.
+void* k_arena_alloc_aligned(k_arena* arena, size_t size, size_t align);
+
+/// @brief Allocate storage for @c count objects of @c element_size bytes each, aligned to @c align bytes, without zeroing them.
+/// The total size is checked for overflow.
+/// @ref k_arena_alloc_n
+void* k_arena_alloc_array(k_arena* arena, size_t count, size_t element_size, size_t align);
+
+/// @brief Allocate uninitialized storage for @c Count objects of type @c Type.
+#define k_arena_alloc_n(Arena, Type, Count) \
+    (k_cast(Type*) k_arena_alloc_array((Arena), (Count), sizeof(Type), alignof(Type)))
+
+/// @brief Try to grow the allocation at @c data from @c old_size to @c new_size bytes without moving it.
+/// This only succeeds if @c data is the most recent allocation in the arena and there is room after it in the current block, or, for arenas backed by a virtual memory reservation, anywhere in the reservation.
+/// @return True if the allocation was grown in place, false if it is unchanged and the caller has to allocate and copy instead.
+bool k_arena_try_extend(k_arena* arena, void* data, size_t old_size, size_t new_size);
+
+/// @brief Record the current high-water point of this arena.
+/// @ref k_arena_rewind
+k_arena_checkpoint k_arena_mark(k_arena* arena);
+
+/// @brief Roll this arena back to a point previously recorded with @c k_arena_mark, in constant time.
+/// Everything allocated since the checkpoint is invalidated.
+/// The blocks themselves are kept and reused by later allocations, so scratch-heavy work touches the same memory again; see @c k_arena_trim to release them instead.
+/// Checkpoints must be rewound in LIFO order; rewinding to a checkpoint invalidates every checkpoint taken after it.
+void k_arena_rewind(k_arena* arena, k_arena_checkpoint checkpoint);
+
+/// @brief Return memory past the current high-water point to the system.
+/// Heap-backed arenas free every block after the one currently being allocated from, which only exist after a @c k_arena_rewind.
+/// Arenas backed by a virtual memory reservation discard the committed pages past the cursor, which read as zero if they are used again.
+void k_arena_trim(k_arena* arena);
+
+/// @brief Name what this arena is used for, e.g. "strings" or "tokens", so memory reports can attribute its usage.
+/// @param tag A string which must outlive the arena; usually a literal.
+void k_arena_set_tag(k_arena* arena, const char* tag);
+
+/// @brief Returns the allocation statistics of this arena.
+/// If @c K_ARENA_STATS is disabled, only @c block_count and @c bytes_committed are meaningful.
+k_arena_stats k_arena_get_stats(k_arena* arena);
+
+/// @brief Write a one-line summary of this arena's allocation statistics to @c stream.
+void k_arena_print_stats(k_arena* arena, FILE* stream);
+
+///===--------------------------------------===///
+/// Pool API.
+///===--------------------------------------===///
+
+/// @brief Initialize this pool to allocate from the given arena.
+void k_pool_init(k_pool* pool, k_arena* arena);
+
+/// @brief Allocate @c size bytes from this pool, reusing a freed object of the same size class if there is one.
+/// The memory is not zeroed, and is aligned to at least 16 bytes.
+void* k_pool_alloc(k_pool* pool, size_t size);
+
+/// @brief Return an object to this pool so its storage can be reused.
+/// @param size The size the object was allocated with.
+void k_pool_free(k_pool* pool, void* data, size_t size);
+
+/// @brief Forget every freed object in this pool.
+/// Call this when the pool's arena is rewound past objects the pool may still be holding on to.
+void k_pool_reset(k_pool* pool);
+
+/// @brief Allocate an uninitialized object of type @c Type from a pool.
+#define k_pool_alloc_t(Pool, Type) (k_cast(Type*) k_pool_alloc((Pool), sizeof(Type)))
+
+/// @brief Return an object of type @c Type to a pool.
+#define k_pool_free_t(Pool, Type, Object) k_pool_free((Pool), (Object), sizeof(Type))
+
+///===--------------------------------------===///
+/// Thread pool API.
+///===--------------------------------------===///
+
+/// @brief Returns the number of processors available to this process, at least 1.
+isize_t k_processor_count(void);
+
+/// @brief Create a thread pool with @c worker_count workers, or one per processor if it is not positive.
+/// The thread calling @c k_thread_pool_run is always one of the workers, so this starts one thread fewer than that.
+k_thread_pool* k_thread_pool_create(isize_t worker_count);
+
+/// @brief Stop and join every worker thread, then free the pool.
+void k_thread_pool_destroy(k_thread_pool* pool);
+
+/// @brief Returns the number of workers in the pool, including the thread calling @c k_thread_pool_run.
+isize_t k_thread_pool_get_worker_count(k_thread_pool* pool);
+
+/// @brief Call @c callback once for every task index in [0, @c task_count) across the workers of the pool, and return once all of them have finished.
+/// Each worker starts on an even share of consecutive indices and steals the back half of another worker's remaining share whenever it runs out.
+/// Which worker runs which task depends on scheduling, so anything the tasks produce should be stored by task index rather than in order of completion.
+void k_thread_pool_run(k_thread_pool* pool, isize_t task_count, k_task_callback callback, void* userdata);
+
+///===--------------------------------------===///
+/// Dynamic array API.
+///===--------------------------------------===///
+
+/// @brief The out-of-line growth path shared by every dynamic array; use the @c k_da_* macros instead of calling this directly.
+/// Reallocates the array's storage to hold at least @c min_capacity elements, in place if the arena allows it, and updates @c *capacity.
+/// @param exact If true, grow to exactly @c min_capacity elements rather than geometrically.
+/// @return The (possibly moved) storage of the array.
+void* k_da_grow(k_arena* arena, void* data, isize_t count, isize_t* capacity, size_t element_size, isize_t min_capacity, bool exact);
+
+/// @brief The out-of-line shrink path of @c k_da_shrink_to_fit; use that macro instead of calling this directly.
+/// @return The (possibly moved) storage of the array.
+void* k_da_shrink(k_arena* arena, void* data, isize_t count, isize_t* capacity, size_t element_size);
+
 ///===--------------------------------------===///
 /// Unicode API.
 ///===--------------------------------------===///
 
 /// @brief Decodes a UTF-8 codepoint from byte-string data.
-/// @param data The input data, assumed to be valid UTF-8 bytes.
+/// Decoding is driven by a small state machine, and is strict: overlong encodings, surrogates and values past U+10FFFF are all rejected.
+/// @param data The input data.
 /// @param data_count The number of bytes available in the input data.
 /// @param offset The offset into the input data to decode from. Should be in the range [0, @c data_count) to attempt decoding.
 /// @param out_codepoint If non-null, the memory to populate with the decoded codepoint value.
 /// @param out_stride If non-null, the memory to populate with the byte stride of the decoded codepoint value.
+/// If decoding fails because the sequence is ill-formed, this is populated with the length of the ill-formed sequence instead, always at least 1, so decoding can resume after it.
 /// @return @c K_UNICODE_SUCCESS if a codepoint was successfully decoded, otherwise another @c k_unicode_decode_result value indicating the reason for failure.
 k_unicode_decode_result k_utf8_decode(const char* data, isize_t data_count, isize_t offset, int32_t* out_codepoint, isize_t* out_stride);
 
+/// @brief Decodes up to @c max_codepoints codepoints starting at @c *offset, for callers which walk text a batch at a time rather than calling @c k_utf8_decode per codepoint.
+/// Each ill-formed sequence decodes to @c K_UNICODE_REPLACEMENT_CHARACTER, as reported by @c k_utf8_validate.
+/// @param offset The offset to start decoding from, which is advanced past everything decoded.
+/// @param out_codepoints The memory to populate with the decoded codepoints, with room for at least @c max_codepoints of them.
+/// @param out_offsets If non-null, the memory to populate with the byte offset each decoded codepoint starts at, with room for at least @c max_codepoints of them.
+/// @return The number of codepoints decoded, which is less than @c max_codepoints only if the end of the data was reached.
+isize_t k_utf8_decode_many(const char* data, isize_t data_count, isize_t* offset, int32_t* out_codepoints, isize_t* out_offsets, isize_t max_codepoints);
+
+/// @brief Returns the number of leading bytes of @c data which are ASCII, that is the offset of the first byte with its high bit set, or @c count if there is none.
+/// Scans 16 or 32 bytes at a time with SSE2 or AVX2 where available, and a word at a time otherwise.
+isize_t k_ascii_prefix_length(const char* data, isize_t count);
+
+/// @brief Find the first ill-formed UTF-8 sequence in @c data at or after @c offset.
+/// Overlong encodings, surrogates and values past U+10FFFF are all rejected, exactly as @c k_utf8_decode rejects them.
+/// ASCII runs are skipped with @c k_ascii_prefix_length, so mostly-ASCII text is validated at close to memory speed.
+/// @param out_error If non-null, the memory to populate with the reason the sequence is ill-formed.
+/// @param out_error_length If non-null, the memory to populate with the length of the ill-formed sequence, always at least 1; resume validating after it to find the next one.
+/// @return The offset of the first ill-formed sequence, or @c count if there is none.
+isize_t k_utf8_validate(const char* data, isize_t count, isize_t offset, k_unicode_decode_result* out_error, isize_t* out_error_length);
+
+/// @brief Returns true if @c codepoint has the Unicode XID_Start property, i.e. it may begin an identifier.
+/// Looks the codepoint up in a three-level bitmap trie of a few KB, generated by src/gen_k_unicode_xid.c.
+bool k_unicode_is_xid_start(int32_t codepoint);
+
+/// @brief Returns true if @c codepoint has the Unicode XID_Continue property, i.e. it may appear in an identifier after the first character.
+bool k_unicode_is_xid_continue(int32_t codepoint);
+
 ///===--------------------------------------===///
 /// Strings API.
 ///===--------------------------------------===///
@@ -362,6 +728,29 @@ void k_sprintf(k_string* s, const char* format, ...);
 /// @brief Appends formatted text to the given string.
 void k_vsprintf(k_string* s, const char* format, va_list v);
 
+/// @brief Hash @c count bytes of @c data, a word at a time.
+/// This is not a cryptographic hash; it is intended for hash tables.
+uint64_t k_hash_bytes(const void* data, isize_t count);
+
+///===--------------------------------------===///
+/// String interning API.
+///===--------------------------------------===///
+
+/// @brief Initialize this intern table, allocating the table and every interned spelling from @c arena.
+void k_intern_table_init(k_intern_table* table, k_arena* arena);
+
+/// @brief Returns the handle of @c text, copying it into the table if it has not been seen before.
+/// Interned spellings are NUL-terminated. The empty string is always @c K_INTERN_ID_NONE.
+k_intern_id k_intern(k_intern_table* table, k_string_view text);
+
+/// @brief Returns the handle of @c text if it has already been interned, otherwise @c K_INTERN_ID_NONE.
+/// Unlike @c k_intern, this never adds to the table.
+k_intern_id k_intern_find(k_intern_table* table, k_string_view text);
+
+/// @brief Returns the spelling of an interned string.
+/// The handle @c K_INTERN_ID_NONE has an empty spelling.
+k_string_view k_intern_get(k_intern_table* table, k_intern_id id);
+
 ///===--------------------------------------===///
 /// Diagnostic API.
 ///===--------------------------------------===///
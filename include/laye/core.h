@@ -75,13 +75,81 @@ typedef enum ly_lexer_mode {
     LY_LEXMODE_REJECTED_BRANCH = 1 << 4,
 } ly_lexer_mode;
 
+/// @brief The keywords of one set of enabled dialects, precomputed so that lexing never re-evaluates availability flags.
+/// @ref ly_keyword_table_get_builtin
+typedef struct ly_keyword_table ly_keyword_table;
+
+/// @brief A point in normalized source text from which offsets trail the original text by @c delta bytes.
+/// @ref ly_normalized_source
+typedef struct ly_source_offset {
+    isize_t normalized_offset;
+    isize_t delta;
+} ly_source_offset;
+
+/// @brief Source text after translation phases 1 and 2: every newline sequence folded to a single '\n' and, for C, line splices removed.
+/// @ref ly_source_normalize
+typedef struct ly_normalized_source {
+    /// @brief The source this was normalized from.
+    ch_source* source;
+    /// @brief The normalized text, NUL-terminated if it is a copy.
+    /// This is the source's own text when normalizing would not change it, which is the common case.
+    k_string_view text;
+    /// @brief Every point where offsets into @c text stop lining up with offsets into the original text, in increasing order.
+    /// Empty if @c text is the source's own text.
+    struct {
+        K_DA_DECLARE_INLINE(ly_source_offset);
+    } offsets;
+} ly_normalized_source;
+
 /// @brief Token information for all variants of C and Laye.
 /// @ref ly_token_kind
 typedef struct ly_token ly_token;
 
-/// @brief A dynamic array of tokens.
+/// @brief The flags of a token, packed into a byte in a @c ly_tokens buffer.
+/// @ref ly_token
+typedef enum ly_token_flags {
+    LY_TOKEN_FLAG_NONE = 0,
+    LY_TOKEN_FLAG_AT_START_OF_LINE = 1 << 0,
+    LY_TOKEN_FLAG_HAS_WHITE_SPACE_BEFORE = 1 << 1,
+    LY_TOKEN_FLAG_EXPANSION_DISABLED = 1 << 2,
+} ly_token_flags;
+
+/// @brief The value of a token which has one besides its spelling, stored out of line in a @c ly_tokens buffer.
+/// Each member lines up with the member of the same name in @c ly_token.
+typedef union ly_token_payload {
+    k_string_view text_value;
+    int32_t character_constant;
+    int64_t integer_constant;
+    double floating_constant;
+    k_string_view string_literal;
+} ly_token_payload;
+
+/// @brief A buffer of tokens stored as one array per field, about 15 bytes per token where a @c ly_token takes 64.
+/// Lookahead only ever needs to touch @c kinds, which can be read directly; use @c ly_tokens_get to unpack a whole token.
+/// The per-token arrays share a single block in an arena of the buffer's own, so growing them rarely copies; payloads grow from the context's node arena.
+/// @ref ly_tokens_init
 typedef struct ly_tokens {
-    K_DA_DECLARE_INLINE(ly_token);
+    ch_context* context;
+    isize_t count;
+    isize_t capacity;
+
+    /// @brief The @c ly_token_kind of each token.
+    uint16_t* kinds;
+    /// @brief The @c ly_token_flags of each token.
+    uint8_t* flags;
+    /// @brief The location each token's range begins at.
+    ch_location* begins;
+    /// @brief The location each token's range ends at.
+    ch_location* ends;
+    /// @brief The interned spelling of each identifier or keyword, the index in @c payloads of the value of each token which has one, otherwise 0.
+    uint32_t* data;
+
+    /// @brief The values of the tokens which have one; identifiers and keywords do not, since their interned spelling is all there is to them.
+    struct {
+        K_DA_DECLARE_INLINE(ly_token_payload);
+    } payloads;
+    /// @brief Holds the one block the per-token arrays are carved from, and nothing else.
+    k_arena arena;
 } ly_tokens;
 
 /// @brief Node in the Laye untyped syntax tree.
@@ -137,8 +205,14 @@ struct ly_token {
     k_string_view preprocessor_file;
 
     union {
-        /// @brief The textual value of this token for identifiers, preprocessing numbers and keywords.
-        k_string_view text_value;
+        struct {
+            /// @brief The textual value of this token for identifiers, preprocessing numbers and keywords.
+            /// For preprocessing numbers this points straight into the source text unless the spelling contains line splices, in which case it is a copy with them removed.
+            k_string_view text_value;
+            /// @brief The interned spelling of this identifier or keyword in the context's intern table, or @c K_INTERN_ID_NONE for other tokens.
+            /// @c text_value is the interned spelling, so the two always agree.
+            k_intern_id text_id;
+        };
         /// @brief The value of this character constant.
         int32_t character_constant;
         /// @brief The value of this integer constant.
@@ -154,15 +228,46 @@ struct ly_lexer {
     ch_context* context;
 
     ch_source* source;
+    /// @brief The text actually lexed; positions in the lexer are offsets into this, and are mapped back to the source's own text for ranges and diagnostics.
+    ly_normalized_source normalized;
     isize_t current_position;
     isize_t current_stride;
     int32_t current_codepoint;
 
+    /// @brief The file name __FILE__ expands to.
+    /// There is no line counterpart; __LINE__ comes from decoding a token's location, which uses the source's line table.
     k_string_view current_file_name;
-    int64_t current_line_number;
 
+    /// @brief The mode the lexer is in. Change it only with @c ly_lexer_push_mode and @c ly_lexer_pop_mode, which keep everything derived from it below up to date.
     ly_lexer_mode mode;
+    /// @brief The modes saved by @c ly_lexer_push_mode, @c LY_LEXER_MODE_BITS bits each, the most recent in the lowest bits.
+    uint64_t mode_stack;
+    /// @brief The number of modes saved in @c mode_stack.
+    int mode_stack_depth;
+
+    /// @brief What the first byte of a token says it is, for the language of the current mode.
+    const uint8_t* byte_classes;
+    /// @brief The punctuators of the current mode's language.
+    ly_token_key punctuator_keys;
+    /// @brief True if block comments nest in the current mode's language, as they do in Laye.
+    bool nests_block_comments;
+    /// @brief False within a preprocessing directive, which the newline ending it is a token of.
+    bool newlines_are_trivia;
+    /// @brief False within a rejected conditional branch, whose text is only skipped.
+    bool reports_diagnostics;
+
     bool is_at_start_of_line;
+
+    /// @brief The keywords recognized in C modes, the C23 keywords by default.
+    /// Chosen when the lexer is initialized and kept across every mode change.
+    /// @ref ly_lexer_set_keyword_table
+    const ly_keyword_table* c_keyword_table;
+    /// @brief The keywords recognized in Laye modes, the Laye keywords by default.
+    /// Chosen when the lexer is initialized and kept across every mode change.
+    /// @ref ly_lexer_set_keyword_table
+    const ly_keyword_table* laye_keyword_table;
+    /// @brief The keywords recognized in the current mode, one of the two tables above; identifiers spelling any other keyword are lexed as plain identifiers.
+    const ly_keyword_table* keyword_table;
 };
 
 struct ly_preprocessor {
@@ -188,6 +293,97 @@ CHOIR_API const char* ly_token_kind_get_spelling(ly_token_kind kind);
 /// @ref ly_token_key
 CHOIR_API ly_token_key ly_token_kind_get_key(ly_token_kind kind);
 
+/// @brief Returns the keyword token kind spelled by @c spelling if it is a keyword in any of the dialects in @c keys, or in any they imply.
+/// Otherwise returns `LY_TK_PP_NOT_KEYWORD`.
+/// This is a perfect hash lookup generated at build time from the @c CH_KEYWORD entries of tokens.h; a miss never compares strings.
+/// @ref ly_token_key
+/// @ref ly_token_key_normalize
+CHOIR_API ly_token_kind ly_token_kind_from_keyword(k_string_view spelling, ly_token_key keys);
+
+/// @brief Returns @c keys with every dialect flag the enabled ones imply added.
+/// C99 and C23 imply C, C23 also implies C99 and a built-in @c bool, and Microsoft compatibility mode implies Microsoft extensions.
+CHOIR_API ly_token_key ly_token_key_normalize(ly_token_key keys);
+
+/// @brief Returns the built-in keyword table for the dialects in @c keys, or @c nullptr if there is none for them.
+/// There are built-in tables for Laye and for C23, the ones the lexer uses; they are generated at build time, so any number of lexers on any number of threads can share them.
+/// @ref ly_token_key_normalize
+CHOIR_API const ly_keyword_table* ly_keyword_table_get_builtin(ly_token_key keys);
+
+/// @brief Build a keyword table for the dialects in @c keys, allocated from @c arena.
+/// A table never changes once built, so it can be shared between lexers and threads as long as the arena lives.
+/// @ref ly_token_key_normalize
+CHOIR_API const ly_keyword_table* ly_keyword_table_create(k_arena* arena, ly_token_key keys);
+
+/// @brief Returns the keyword token kind spelled by @c spelling in this table's dialects, otherwise `LY_TK_PP_NOT_KEYWORD`.
+/// Equivalent to @c ly_token_kind_from_keyword with the table's dialects, without checking any availability flags.
+CHOIR_API ly_token_kind ly_keyword_table_lookup(const ly_keyword_table* table, k_string_view spelling);
+
+/// @brief Set the C dialects whose keywords the C lexers of @c context recognize; until this is called they recognize the C23 keywords.
+/// The keyword table is the built-in one for these dialects if there is one, otherwise it is built here, once, in the context's string arena.
+/// Call this before lexing any C in the context: lexers already initialized keep the table they started with.
+/// @param keys The dialect flags, which must include C, or a C standard implying it, and not Laye.
+/// @ref ly_token_key_normalize
+CHOIR_API void ly_context_set_c_dialect(ch_context* context, ly_token_key keys);
+
+///===--------------------------------------===///
+/// Token buffer API.
+///===--------------------------------------===///
+
+/// @brief Initialize an empty token buffer in the given context.
+CHOIR_API void ly_tokens_init(ly_tokens* tokens, ch_context* context);
+
+/// @brief Free the per-token arrays of a token buffer; its payloads live as long as the context does.
+CHOIR_API void ly_tokens_deinit(ly_tokens* tokens);
+
+/// @brief Make room for at least @c capacity tokens in total, so that appending up to that many never grows the buffer.
+CHOIR_API void ly_tokens_reserve(ly_tokens* tokens, isize_t capacity);
+
+/// @brief Append a token to the buffer, packing its fields into the buffer's arrays.
+/// The preprocessor line and file of the token are not kept.
+CHOIR_API void ly_tokens_push(ly_tokens* tokens, const ly_token* token);
+
+/// @brief Append every token of @c other to @c tokens.
+/// @c other may belong to another context, as it does when it was lexed on a worker thread, in which case identifiers are interned again into the context of @c tokens and any token text which is not a view of its source is copied into its string arena.
+/// @param text_id_map Only needed if the contexts differ: one zeroed entry per string in the intern table of @c other's context, mapping its handles to handles in this one.
+/// Keep it for every call appending from the same context, so each spelling is only interned again once.
+CHOIR_API void ly_tokens_append(ly_tokens* tokens, const ly_tokens* other, k_intern_id* text_id_map);
+
+/// @brief Unpack the token at @c index into a @c ly_token.
+/// Its preprocessor line and file are left zero, since the buffer does not keep them.
+CHOIR_API ly_token ly_tokens_get(const ly_tokens* tokens, isize_t index);
+
+/// @brief Returns the kind of the token at @c index.
+CHOIR_API ly_token_kind ly_tokens_kind(const ly_tokens* tokens, isize_t index);
+
+/// @brief Returns the flags of the token at @c index.
+CHOIR_API ly_token_flags ly_tokens_flags(const ly_tokens* tokens, isize_t index);
+
+/// @brief Returns the source range of the token at @c index.
+CHOIR_API ch_range ly_tokens_range(const ly_tokens* tokens, isize_t index);
+
+/// @brief Returns the interned spelling of the token at @c index if it is an identifier or keyword, otherwise @c K_INTERN_ID_NONE.
+CHOIR_API k_intern_id ly_tokens_text_id(const ly_tokens* tokens, isize_t index);
+
+///===--------------------------------------===///
+/// Source API.
+///===--------------------------------------===///
+
+/// @brief Run translation phases 1 and 2 over a source once, so a lexer never has to handle newline sequences or line splices itself.
+/// Sources without any carriage returns or (if @c splice_lines is set) line splices are not copied; the result refers to their text directly.
+/// Otherwise the normalized text and its offset map are allocated in the context's string arena.
+/// The source is added to the context first if it has not been yet, so that its errors have locations, and then its encoding is checked.
+/// @param splice_lines True to remove backslash-newline line splices, as C requires.
+/// @ref ly_source_check_encoding
+CHOIR_API void ly_source_normalize(ly_normalized_source* normalized, ch_context* context, ch_source* source, bool splice_lines);
+
+/// @brief Report every ill-formed UTF-8 sequence in a source, unless its encoding has been checked before.
+/// The lexer decodes leniently, substituting U+FFFD for anything reported here, so it never has to diagnose encoding errors itself.
+/// The source must already have been added to a context.
+CHOIR_API void ly_source_check_encoding(ch_context* context, ch_source* source);
+
+/// @brief Returns the offset in the original source text of an offset into normalized text.
+CHOIR_API isize_t ly_source_original_offset(const ly_normalized_source* normalized, isize_t offset);
+
 ///===--------------------------------------===///
 /// Lexer API.
 ///===--------------------------------------===///
@@ -200,6 +396,11 @@ CHOIR_API ly_token_key ly_token_kind_get_key(ly_token_kind kind);
 /// @param mode The initial mode to start the lexer in.
 CHOIR_API void ly_lexer_init(ly_lexer* lexer, ch_context* context, ch_source* source, ly_lexer_mode mode);
 
+/// @brief Initialize a lexer over a source which was already normalized, as @c ly_lexer_init does after normalizing it.
+/// Any number of lexers can share one normalized source, including lexers in other contexts; the source is only read.
+/// @ref ly_source_normalize
+CHOIR_API void ly_lexer_init_normalized(ly_lexer* lexer, ch_context* context, const ly_normalized_source* normalized, ly_lexer_mode mode);
+
 /// @brief Stage the next character (and stride) in the lexer.
 /// See @c lexer->current_codepoint for the decoded character codepoint and @c lexer->current_stride for the number of bytes comprising that codepoint.
 CHOIR_API void ly_lexer_next_character(ly_lexer* lexer);
@@ -209,7 +410,40 @@ CHOIR_API void ly_lexer_next_character(ly_lexer* lexer);
 /// This is largely only necessary for @c pp-number or @c pp-identifier tokens from C source text, neither of which will survive in Laye lexing modes, but the API name remains the same regardless as Laye still assumes a preprocessor.
 CHOIR_API ly_token ly_lexer_read_pp_token(ly_lexer* lexer);
 
+/// @brief Lex tokens into @c tokens starting at @c position in the normalized text, until the position after one is at or past @c end_position, and return that position.
+/// A token which starts before @c end_position is always lexed in full, along with its trailing trivia, so the returned position can be past it.
+/// Lexing stops after an @c LY_TK_END_OF_FILE token, which ends the tokens if the end of the text is reached.
+/// The position is taken and returned rather than kept in the lexer, which is only left with what it knows about the next token's line.
+CHOIR_API isize_t ly_lexer_lex_until(ly_lexer* lexer, isize_t position, isize_t end_position, ly_tokens* tokens);
+
+/// @brief The number of source bytes per token @c ly_lexer_lex_all sizes its output for.
+/// Real code runs from about 3 bytes per token for dense macro tables to well over 5 with comments, so this rarely has to grow the buffer.
+#define LY_LEXER_BYTES_PER_TOKEN_ESTIMATE 3
+
+/// @brief Lex all of @c source in the given mode, appending its tokens to @c tokens and ending them with exactly one @c LY_TK_END_OF_FILE token.
+/// The tokens are the same as reading the source one @c ly_lexer_read_pp_token at a time, but go straight into the buffer, which is reserved up front from the size of the source.
+/// @ref LY_LEXER_BYTES_PER_TOKEN_ESTIMATE
+CHOIR_API void ly_lexer_lex_all(ch_source* source, ly_lexer_mode mode, ly_tokens* tokens);
+
+/// @brief Lex every source in @c sources at once on the workers of @c pool, as @c ly_lexer_lex_all would, into the matching element of @c out_tokens.
+/// Each worker lexes into a context of its own, with its own arenas and intern table, and the results are merged back into @c context in source order.
+/// The tokens, their interned spellings and the diagnostics reported are exactly those of lexing the sources one after another, whatever the scheduling.
+/// @param out_tokens An array of @c source_count token buffers, which are initialized by this call.
+CHOIR_API void ly_lexer_lex_sources(ch_context* context, k_thread_pool* pool, ch_source** sources, isize_t source_count, ly_lexer_mode mode, ly_tokens* out_tokens);
+
+/// @brief Lex all of one large @c source on the workers of @c pool, with exactly the result of @c ly_lexer_lex_all.
+/// The source is split into chunks at newlines which look to be outside comments and directives, and every chunk is lexed speculatively, as if it started a line outside of one.
+/// Each seam is then checked against the state the chunk before it actually ended in, and lexed again serially where the guess was wrong until the two agree.
+/// Sources too small to be worth splitting, and modes in which newlines are tokens, are lexed with @c ly_lexer_lex_all.
+CHOIR_API void ly_lexer_lex_all_parallel(k_thread_pool* pool, ch_source* source, ly_lexer_mode mode, ly_tokens* tokens);
+
+/// @brief The number of bits each mode saved by @c ly_lexer_push_mode takes.
+#define LY_LEXER_MODE_BITS 5
+/// @brief How many modes can be pushed before any is popped; the preprocessor only ever nests a couple.
+#define LY_LEXER_MODE_STACK_DEPTH (64 / LY_LEXER_MODE_BITS)
+
 /// @brief Push a new lexer mode, overriding the previous one for the duration.
+/// The previous mode is saved in the lexer itself, so pushing and popping never allocate; at most @c LY_LEXER_MODE_STACK_DEPTH modes can be saved at once.
 /// @ref ly_lexer_pop_mode
 CHOIR_API void ly_lexer_push_mode(ly_lexer* lexer, ly_lexer_mode mode);
 
@@ -217,6 +451,11 @@ CHOIR_API void ly_lexer_push_mode(ly_lexer* lexer, ly_lexer_mode mode);
 /// @ref ly_lexer_push_mode
 CHOIR_API void ly_lexer_pop_mode(ly_lexer* lexer);
 
+/// @brief Replace the keywords the lexer recognizes in the language of its current mode, Laye or C.
+/// The table is kept across mode pushes and pops, and is only read, so it can be shared; it must outlive the lexer.
+/// @ref ly_keyword_table_create
+CHOIR_API void ly_lexer_set_keyword_table(ly_lexer* lexer, const ly_keyword_table* table);
+
 ///===--------------------------------------===///
 /// Preprocessor API.
 ///===--------------------------------------===///
@@ -12,8 +12,9 @@
 /// Lexical diagnostics.
 ///===--------------------------------------===///
 
-CHOIR_API void ly_err_invalid_character(k_diag* diag, ch_source* source, isize_t location);
-CHOIR_API void ly_err_unclosed_comment(k_diag* diag, ch_source* source, isize_t location);
+CHOIR_API void ly_err_invalid_character(ch_context* context, ch_location location);
+CHOIR_API void ly_err_invalid_utf8(ch_context* context, ch_location location, k_unicode_decode_result reason);
+CHOIR_API void ly_err_unclosed_comment(ch_context* context, ch_location location);
 
 ///===--------------------------------------===///
 /// Preprocessing diagnostics.
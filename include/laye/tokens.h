@@ -3,7 +3,7 @@
 #endif
 
 #ifndef CH_PUNCT
-#    define CH_PUNCT(id, spelling) LY_TOKEN(id)
+#    define CH_PUNCT(id, spelling, flags) LY_TOKEN(id)
 #endif
 
 #ifndef CH_KEYWORD
@@ -127,65 +127,69 @@ LY_TOKEN(UTF32_STRING_LITERAL) //  U"foo"
 LY_TOKEN(HEADER_NAME)
 
 /// === C23 6.4.6 - Punctuators.
-CH_PUNCT(HASH, "#")
-CH_PUNCT(HASH_HASH, "##")
-CH_PUNCT(OPEN_PAREN, "(")
-CH_PUNCT(CLOSE_PAREN, ")")
-CH_PUNCT(OPEN_SQUARE, "[")
-CH_PUNCT(CLOSE_SQUARE, "]")
-CH_PUNCT(OPEN_CURLY, "{")
-CH_PUNCT(CLOSE_CURLY, "}")
-CH_PUNCT(COMMA, ",")
-CH_PUNCT(SEMI_COLON, ";")
-CH_PUNCT(DOT, ".")
-CH_PUNCT(DOT_DOT_DOT, "...")
-CH_PUNCT(COLON, ":")
-CH_PUNCT(COLON_COLON, "::")
-CH_PUNCT(EQUAL, "=")
-CH_PUNCT(EQUAL_EQUAL, "==")
-CH_PUNCT(EQUAL_GREATER, "=>")
-CH_PUNCT(BANG, "!")
-CH_PUNCT(BANG_EQUAL, "!=")
-CH_PUNCT(LESS, "<")
-CH_PUNCT(LESS_EQUAL, "<=")
-CH_PUNCT(LESS_LESS, "<<")
-CH_PUNCT(LESS_LESS_EQUAL, "<<=")
-CH_PUNCT(GREATER, ">")
-CH_PUNCT(GREATER_EQUAL, ">=")
-CH_PUNCT(GREATER_GREATER, ">>")
-CH_PUNCT(GREATER_GREATER_EQUAL, ">>=")
-CH_PUNCT(PLUS, "+")
-CH_PUNCT(PLUS_EQUAL, "+=")
-CH_PUNCT(PLUS_PLUS, "++")
-CH_PUNCT(MINUS, "-")
-CH_PUNCT(MINUS_EQUAL, "-=")
-CH_PUNCT(MINUS_MINUS, "--")
-CH_PUNCT(MINUS_GREATER, "->")
-CH_PUNCT(STAR, "*")
-CH_PUNCT(STAR_EQUAL, "*=")
-CH_PUNCT(SLASH, "/")
-CH_PUNCT(SLASH_EQUAL, "/=")
-CH_PUNCT(PERCENT, "%")
-CH_PUNCT(PERCENT_EQUAL, "%=")
-CH_PUNCT(CARET, "^")
-CH_PUNCT(CARET_EQUAL, "^=")
-CH_PUNCT(TILDE, "~")
-CH_PUNCT(AMPERSAND, "&")
-CH_PUNCT(AMPERSAND_EQUAL, "&=")
-CH_PUNCT(AMPERSAND_AMPERSAND, "&&")
-CH_PUNCT(PIPE, "|")
-CH_PUNCT(PIPE_EQUAL, "|=")
-CH_PUNCT(PIPE_PIPE, "||")
-CH_PUNCT(QUESTION, "?")
+///
+/// The flags say in which languages each punctuator is recognized, as for keywords below.
+/// The lexer's punctuator recognizer is generated from these by src/gen_ly_punctuators.c.
+CH_PUNCT(HASH, "#", LY_TKKEY_ALL)
+CH_PUNCT(HASH_HASH, "##", LY_TKKEY_C)
+CH_PUNCT(OPEN_PAREN, "(", LY_TKKEY_ALL)
+CH_PUNCT(CLOSE_PAREN, ")", LY_TKKEY_ALL)
+CH_PUNCT(OPEN_SQUARE, "[", LY_TKKEY_ALL)
+CH_PUNCT(CLOSE_SQUARE, "]", LY_TKKEY_ALL)
+CH_PUNCT(OPEN_CURLY, "{", LY_TKKEY_ALL)
+CH_PUNCT(CLOSE_CURLY, "}", LY_TKKEY_ALL)
+CH_PUNCT(COMMA, ",", LY_TKKEY_ALL)
+CH_PUNCT(SEMI_COLON, ";", LY_TKKEY_ALL)
+CH_PUNCT(DOT, ".", LY_TKKEY_ALL)
+CH_PUNCT(DOT_DOT_DOT, "...", LY_TKKEY_C)
+CH_PUNCT(COLON, ":", LY_TKKEY_ALL)
+CH_PUNCT(COLON_COLON, "::", LY_TKKEY_ALL)
+CH_PUNCT(EQUAL, "=", LY_TKKEY_ALL)
+CH_PUNCT(EQUAL_EQUAL, "==", LY_TKKEY_ALL)
+CH_PUNCT(EQUAL_GREATER, "=>", LY_TKKEY_LAYE)
+CH_PUNCT(BANG, "!", LY_TKKEY_ALL)
+CH_PUNCT(BANG_EQUAL, "!=", LY_TKKEY_ALL)
+CH_PUNCT(LESS, "<", LY_TKKEY_ALL)
+CH_PUNCT(LESS_EQUAL, "<=", LY_TKKEY_ALL)
+CH_PUNCT(LESS_LESS, "<<", LY_TKKEY_ALL)
+CH_PUNCT(LESS_LESS_EQUAL, "<<=", LY_TKKEY_ALL)
+CH_PUNCT(GREATER, ">", LY_TKKEY_ALL)
+CH_PUNCT(GREATER_EQUAL, ">=", LY_TKKEY_ALL)
+CH_PUNCT(GREATER_GREATER, ">>", LY_TKKEY_ALL)
+CH_PUNCT(GREATER_GREATER_EQUAL, ">>=", LY_TKKEY_ALL)
+CH_PUNCT(PLUS, "+", LY_TKKEY_ALL)
+CH_PUNCT(PLUS_EQUAL, "+=", LY_TKKEY_ALL)
+CH_PUNCT(PLUS_PLUS, "++", LY_TKKEY_ALL)
+CH_PUNCT(MINUS, "-", LY_TKKEY_ALL)
+CH_PUNCT(MINUS_EQUAL, "-=", LY_TKKEY_ALL)
+CH_PUNCT(MINUS_MINUS, "--", LY_TKKEY_ALL)
+CH_PUNCT(MINUS_GREATER, "->", LY_TKKEY_ALL)
+CH_PUNCT(STAR, "*", LY_TKKEY_ALL)
+CH_PUNCT(STAR_EQUAL, "*=", LY_TKKEY_ALL)
+CH_PUNCT(SLASH, "/", LY_TKKEY_ALL)
+CH_PUNCT(SLASH_EQUAL, "/=", LY_TKKEY_ALL)
+CH_PUNCT(PERCENT, "%", LY_TKKEY_ALL)
+CH_PUNCT(PERCENT_EQUAL, "%=", LY_TKKEY_ALL)
+CH_PUNCT(CARET, "^", LY_TKKEY_ALL)
+CH_PUNCT(CARET_EQUAL, "^=", LY_TKKEY_ALL)
+CH_PUNCT(TILDE, "~", LY_TKKEY_ALL)
+CH_PUNCT(AMPERSAND, "&", LY_TKKEY_ALL)
+CH_PUNCT(AMPERSAND_EQUAL, "&=", LY_TKKEY_ALL)
+CH_PUNCT(AMPERSAND_AMPERSAND, "&&", LY_TKKEY_ALL)
+CH_PUNCT(PIPE, "|", LY_TKKEY_ALL)
+CH_PUNCT(PIPE_EQUAL, "|=", LY_TKKEY_ALL)
+CH_PUNCT(PIPE_PIPE, "||", LY_TKKEY_ALL)
+CH_PUNCT(QUESTION, "?", LY_TKKEY_ALL)
 
 /// === Laye - (Non-C) Punctuators.
-CH_PUNCT(HASH_SQUARE, "#[")
-CH_PUNCT(DOT_DOT, "..")
-CH_PUNCT(DOT_DOT_EQUAL, "..=")
-CH_PUNCT(LESS_EQUAL_GREATER, "<=>")
-CH_PUNCT(TILDE_EQUAL, "~=")
-CH_PUNCT(QUESTION_QUESTION, "??")
-CH_PUNCT(QUESTION_QUESTION_EQUAL, "??=")
+CH_PUNCT(HASH_SQUARE, "#[", LY_TKKEY_LAYE)
+CH_PUNCT(DOT_DOT, "..", LY_TKKEY_LAYE)
+CH_PUNCT(DOT_DOT_EQUAL, "..=", LY_TKKEY_LAYE)
+CH_PUNCT(LESS_EQUAL_GREATER, "<=>", LY_TKKEY_LAYE)
+CH_PUNCT(TILDE_EQUAL, "~=", LY_TKKEY_LAYE)
+CH_PUNCT(QUESTION_QUESTION, "??", LY_TKKEY_LAYE)
+// Escaped so that compilers still doing trigraphs do not read "??=" as "#".
+CH_PUNCT(QUESTION_QUESTION_EQUAL, "?\?=", LY_TKKEY_LAYE)
 
 /// === C23 6.4.1 - Keywords.
 ///
@@ -1,8 +1,31 @@
 #include <choir/core.h>
 
-CHOIR_API void ch_context_init(ch_context* context, k_diag* diag, k_arena* string_arena) {
+CHOIR_API void ch_context_init(ch_context* context, k_diag* diag, k_arena* string_arena, k_arena* node_arena) {
     *context = (ch_context){
         .diag = diag,
         .string_arena = string_arena,
+        .node_arena = node_arena,
+        .source_manager = {
+            .entries.arena = string_arena,
+            // Locations start at 1 so that CH_LOCATION_NONE is never handed out.
+            .next_location = CH_LOCATION_NONE + 1,
+        },
+        .tab_width = CH_DEFAULT_TAB_WIDTH,
     };
+
+    k_pool_init(&context->node_pool, node_arena);
+    k_intern_table_init(&context->intern_table, string_arena);
+}
+
+CHOIR_API void ch_context_print_memory_report(ch_context* context, FILE* stream) {
+    fprintf(stream, "%-12s %10s %12s %12s %12s %12s %10s %10s %7s\n", "arena", "allocs", "requested", "padding", "in use", "peak", "tail waste", "committed", "blocks");
+    k_arena_print_stats(context->string_arena, stream);
+    if (context->node_arena != context->string_arena) {
+        k_arena_print_stats(context->node_arena, stream);
+    }
+
+    k_arena* diag_arena = context->diag->string_arena;
+    if (diag_arena != context->string_arena && diag_arena != context->node_arena) {
+        k_arena_print_stats(diag_arena, stream);
+    }
 }
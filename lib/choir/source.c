@@ -0,0 +1,212 @@
+#include <choir/core.h>
+
+#if defined(K_SSE2)
+#    include <emmintrin.h>
+#endif // K_SSE2
+
+/// Hand out the next 'size' locations of the context to a new entry.
+static ch_location ch_source_manager_add(ch_source_manager* manager, ch_source_entry entry, isize_t size) {
+    assert(size >= 0);
+    assert(k_cast(isize_t) UINT32_MAX - manager->next_location >= size && "The sources of a context must fit in 4 GiB of locations");
+
+    entry.location = manager->next_location;
+    entry.size = k_cast(uint32_t) size;
+    k_da_push(&manager->entries, entry);
+
+    manager->next_location += k_cast(uint32_t) size;
+    return entry.location;
+}
+
+CHOIR_API ch_location ch_context_add_source(ch_context* context, ch_source* source) {
+    assert(context != nullptr);
+    assert(source != nullptr);
+    assert(source->location == CH_LOCATION_NONE && "A source can only be added to a context once");
+
+    // The end of the text gets a location too, for ranges ending there and end of file tokens.
+    source->location = ch_source_manager_add(&context->source_manager, (ch_source_entry){ .source = source }, source->text.count + 1);
+    return source->location;
+}
+
+CHOIR_API ch_location ch_context_add_expansion(ch_context* context, ch_location spelling_location, ch_range expansion_range, isize_t length) {
+    assert(context != nullptr);
+
+    ch_source_entry entry = {
+        .spelling_location = spelling_location,
+        .expansion_range = expansion_range,
+    };
+
+    return ch_source_manager_add(&context->source_manager, entry, length + 1);
+}
+
+CHOIR_API ch_location ch_source_get_location(const ch_source* source, isize_t offset) {
+    assert(source != nullptr);
+    assert(source->location != CH_LOCATION_NONE && "The source has not been added to a context");
+    assert(offset >= 0 && offset <= source->text.count);
+    return source->location + k_cast(ch_location) offset;
+}
+
+/// Returns the number of '\n' and '\r' bytes in 'text', which bounds the number of newline sequences in it.
+static isize_t ch_count_newline_bytes(const char* text, isize_t count) {
+    isize_t newline_count = 0;
+    isize_t position = 0;
+
+#if defined(K_SSE2)
+    const __m128i line_feeds = _mm_set1_epi8('\n');
+    const __m128i carriage_returns = _mm_set1_epi8('\r');
+
+    for (; position + 16 <= count; position += 16) {
+        __m128i chunk = _mm_loadu_si128(k_cast(const __m128i*)(text + position));
+        uint32_t newline_bits = k_cast(uint32_t) _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, line_feeds), _mm_cmpeq_epi8(chunk, carriage_returns)));
+        if (newline_bits != 0) newline_count += k_count_ones(newline_bits);
+    }
+#endif // K_SSE2
+
+    for (; position < count; position++) {
+        if (text[position] == '\n' || text[position] == '\r') newline_count++;
+    }
+
+    return newline_count;
+}
+
+/// Returns the length of the newline sequence starting with the '\n' or '\r' at 'position'.
+/// The sequences '\n', '\r', '\r\n' and '\n\r' each count as a single newline, as they do for the lexer.
+static isize_t ch_newline_length(const char* text, isize_t count, isize_t position) {
+    if (position + 1 < count && (text[position + 1] == '\n' || text[position + 1] == '\r') && text[position + 1] != text[position]) {
+        return 2;
+    }
+
+    return 1;
+}
+
+/// Fill in the line table of 'source'.
+/// The table is sized exactly up front from a vectorized count of newline bytes, then filled in by a second vectorized pass.
+static void ch_source_build_line_starts(ch_context* context, ch_source* source) {
+    const char* text = source->text.data;
+    isize_t count = source->text.count;
+
+    source->line_starts.arena = context->string_arena;
+    k_da_reserve_exact(&source->line_starts, ch_count_newline_bytes(text, count) + 1);
+    k_da_push(&source->line_starts, 0);
+
+    // The start of the line after the last newline recorded; a newline byte before it is the second half of a pair.
+    isize_t line_start = 0;
+    isize_t position = 0;
+
+#if defined(K_SSE2)
+    const __m128i line_feeds = _mm_set1_epi8('\n');
+    const __m128i carriage_returns = _mm_set1_epi8('\r');
+
+    for (; position + 16 <= count; position += 16) {
+        __m128i chunk = _mm_loadu_si128(k_cast(const __m128i*)(text + position));
+        uint32_t newline_bits = k_cast(uint32_t) _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, line_feeds), _mm_cmpeq_epi8(chunk, carriage_returns)));
+        while (newline_bits != 0) {
+            isize_t newline_position = position + k_count_trailing_zeros(newline_bits);
+            newline_bits &= newline_bits - 1;
+
+            if (newline_position >= line_start) {
+                line_start = newline_position + ch_newline_length(text, count, newline_position);
+                k_da_push(&source->line_starts, k_cast(uint32_t) line_start);
+            }
+        }
+    }
+#endif // K_SSE2
+
+    for (; position < count; position++) {
+        if ((text[position] == '\n' || text[position] == '\r') && position >= line_start) {
+            line_start = position + ch_newline_length(text, count, position);
+            k_da_push(&source->line_starts, k_cast(uint32_t) line_start);
+        }
+    }
+}
+
+CHOIR_API void ch_source_get_line_column(ch_context* context, ch_source* source, isize_t offset, isize_t* out_line, isize_t* out_column) {
+    assert(context != nullptr);
+    assert(source != nullptr);
+    assert(offset >= 0 && offset <= source->text.count);
+
+    if (source->line_starts.count == 0) {
+        ch_source_build_line_starts(context, source);
+    }
+
+    // Find the last line starting at or before the offset; the first line starts at 0, so there always is one.
+    const uint32_t* line_starts = source->line_starts.data;
+    isize_t low = 0;
+    isize_t high = source->line_starts.count;
+    while (high - low > 1) {
+        isize_t middle = low + (high - low) / 2;
+        if (line_starts[middle] <= offset) {
+            low = middle;
+        } else {
+            high = middle;
+        }
+    }
+
+    // Continuation bytes take no column of their own, so each codepoint is one column; tabs go to the next tab stop.
+    isize_t tab_width = context->tab_width > 0 ? context->tab_width : CH_DEFAULT_TAB_WIDTH;
+    const char* text = source->text.data;
+    isize_t column = 0;
+    for (isize_t i = line_starts[low]; i < offset; i++) {
+        if (text[i] == '\t') {
+            column += tab_width - column % tab_width;
+        } else if ((text[i] & 0xC0) != 0x80) {
+            column++;
+        }
+    }
+
+    if (out_line != nullptr) *out_line = low + 1;
+    if (out_column != nullptr) *out_column = column + 1;
+}
+
+/// Returns the entry whose slice contains 'location', or nullptr if none does.
+static const ch_source_entry* ch_source_manager_find(const ch_source_manager* manager, ch_location location) {
+    if (location == CH_LOCATION_NONE || location >= manager->next_location) {
+        return nullptr;
+    }
+
+    // Entries are in increasing order of location and cover the whole space handed out, so this finds the last one starting at or before it.
+    isize_t low = 0;
+    isize_t high = manager->entries.count;
+    while (high - low > 1) {
+        isize_t middle = low + (high - low) / 2;
+        if (manager->entries.data[middle].location <= location) {
+            low = middle;
+        } else {
+            high = middle;
+        }
+    }
+
+    return &manager->entries.data[low];
+}
+
+CHOIR_API ch_source* ch_context_get_source(ch_context* context, ch_location location) {
+    assert(context != nullptr);
+    const ch_source_entry* entry = ch_source_manager_find(&context->source_manager, location);
+    return entry == nullptr ? nullptr : entry->source;
+}
+
+CHOIR_API ch_decoded_location ch_context_decode_location(ch_context* context, ch_location location) {
+    assert(context != nullptr);
+
+    ch_decoded_location decoded = {0};
+    const ch_source_entry* entry = ch_source_manager_find(&context->source_manager, location);
+
+    // Follow expansions back to the source their text is spelled in, which may take several steps for arguments of nested macros.
+    while (entry != nullptr && entry->source == nullptr) {
+        if (decoded.expansion_range.begin == CH_LOCATION_NONE) {
+            decoded.expansion_range = entry->expansion_range;
+        }
+
+        location = entry->spelling_location + (location - entry->location);
+        entry = ch_source_manager_find(&context->source_manager, location);
+    }
+
+    if (entry == nullptr) {
+        return decoded;
+    }
+
+    decoded.source = entry->source;
+    decoded.offset = location - entry->location;
+
+    ch_source_get_line_column(context, entry->source, decoded.offset, &decoded.line, &decoded.column);
+    return decoded;
+}
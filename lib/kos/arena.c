@@ -1,42 +1,349 @@
+#if defined(__linux__)
+// MAP_ANONYMOUS, MAP_NORESERVE, MAP_HUGETLB and MADV_HUGEPAGE are not exposed in strict ISO C modes otherwise.
+#    define _GNU_SOURCE
+#endif // __linux__
+
 #include <kos/kos.h>
 
+#if defined(K_LINUX)
+#    include <sys/mman.h>
+#endif // K_LINUX
+
 #define K_ARENA_ALIGN      16
 #define K_ARENA_BLOCK_SIZE (8 * 1024 * 1024)
 
+/// The number of bytes committed at a time by arenas backed by a virtual memory reservation.
+#define K_ARENA_COMMIT_SIZE (1024 * 1024)
+/// The size of an explicit huge page, which is also the commit granularity when huge pages are in use.
+#define K_ARENA_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+static bool k_arena_is_virtual(k_arena* arena) {
+    return arena->reserve_base != nullptr;
+}
+
+static uintptr_t k_arena_align_up(uintptr_t value, size_t align) {
+    return (value + (align - 1)) & ~(k_cast(uintptr_t)(align - 1));
+}
+
+#if K_ARENA_STATS
+static void k_arena_count_bytes(k_arena* arena, isize_t padding, isize_t size) {
+    k_arena_stats* stats = &arena->stats;
+    stats->bytes_requested += size;
+    stats->bytes_padding += padding;
+    stats->bytes_in_use += padding + size;
+    if (stats->bytes_in_use > stats->bytes_peak) {
+        stats->bytes_peak = stats->bytes_in_use;
+    }
+}
+#endif // K_ARENA_STATS
+
 void k_arena_init(k_arena* arena) {
     *arena = (k_arena){0};
 }
 
+bool k_arena_init_virtual(k_arena* arena, size_t reserve_size, k_arena_flags flags) {
+    k_arena_init(arena);
+
+#if defined(K_LINUX)
+    size_t granularity = K_ARENA_COMMIT_SIZE;
+    reserve_size = k_cast(size_t) k_arena_align_up(reserve_size, K_ARENA_HUGE_PAGE_SIZE);
+
+    // Nothing is readable or writable until it is committed, and MAP_NORESERVE keeps the untouched range from counting against overcommit.
+    void* base = MAP_FAILED;
+    if (0 != (flags & K_ARENA_HUGE_PAGES)) {
+        // Explicit huge pages must not use MAP_NORESERVE: touching a page the pool cannot supply raises SIGBUS rather than failing here.
+        // Without it the kernel sets aside the whole range from the huge page pool up front, and refuses the mapping if the pool is too small.
+        base = mmap(nullptr, reserve_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (base != MAP_FAILED) {
+            granularity = K_ARENA_HUGE_PAGE_SIZE;
+        } else {
+            // No explicit huge pages are available, so settle for asking for transparent ones instead.
+            flags |= K_ARENA_TRANSPARENT_HUGE_PAGES;
+        }
+    }
+
+    if (base == MAP_FAILED) {
+        base = mmap(nullptr, reserve_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (base == MAP_FAILED) {
+            return false;
+        }
+
+        if (0 != (flags & K_ARENA_TRANSPARENT_HUGE_PAGES)) {
+            // Transparent huge pages only help if commits line up with them.
+            granularity = K_ARENA_HUGE_PAGE_SIZE;
+            k_discard madvise(base, reserve_size, MADV_HUGEPAGE);
+        }
+    }
+
+    arena->reserve_base = base;
+    arena->reserve_limit = k_cast(char*) base + reserve_size;
+    arena->commit_granularity = k_cast(isize_t) granularity;
+    arena->cursor = base;
+    arena->limit = base;
+    return true;
+#else  // !K_LINUX
+    return false;
+#endif // K_LINUX
+}
+
 void k_arena_deinit(k_arena* arena) {
+#if defined(K_LINUX)
+    if (k_arena_is_virtual(arena)) {
+        munmap(arena->reserve_base, k_cast(size_t)(arena->reserve_limit - arena->reserve_base));
+    }
+#endif // K_LINUX
+
     for (isize_t i = 0; i < arena->count; i++) {
         k_arena_block* block = &arena->data[i];
         free(block->data);
     }
 
     k_da_free(arena);
+    *arena = (k_arena){0};
 }
 
-void* k_arena_alloc(k_arena* arena, size_t size) {
-    isize_t aligned_size = k_cast(isize_t)(size + (K_ARENA_ALIGN - (size % K_ARENA_ALIGN)) % K_ARENA_ALIGN);
-    assert(aligned_size > 0);
-    assert(aligned_size <= K_ARENA_BLOCK_SIZE);
+/// Report a failure no allocation can recover from and abort, in every build.
+/// Carrying on would hand out memory the arena does not own, so unlike a failed malloc this is never left to an assert.
+static void k_arena_fatal(k_arena* arena, const char* message) {
+    fprintf(stderr, "Arena %s: %s\n", arena->tag != nullptr ? arena->tag : "<untagged>", message);
+    abort();
+}
+
+/// Commit enough of the reservation that the cursor can be bumped up to 'required_limit'.
+static void k_arena_commit(k_arena* arena, uintptr_t required_limit) {
+#if defined(K_LINUX)
+    // Ordinary input can get here, such as a token buffer outgrowing its reservation, so this is checked even without asserts.
+    if (required_limit > k_cast(uintptr_t) arena->reserve_limit) {
+        k_arena_fatal(arena, "virtual memory reservation exhausted; reserve more address space for it");
+    }
+
+    uintptr_t new_limit = k_arena_align_up(required_limit, k_cast(size_t) arena->commit_granularity);
+    if (new_limit > k_cast(uintptr_t) arena->reserve_limit) {
+        new_limit = k_cast(uintptr_t) arena->reserve_limit;
+    }
+
+    if (0 != mprotect(arena->limit, k_cast(size_t)(new_limit - k_cast(uintptr_t) arena->limit), PROT_READ | PROT_WRITE)) {
+        k_arena_fatal(arena, "could not commit memory from its virtual memory reservation");
+    }
 
-    k_arena_block* block = nullptr;
-    for (isize_t i = 0; block == nullptr && i < arena->count; i++) {
-        if (K_ARENA_BLOCK_SIZE - arena->data[i].count_allocated >= aligned_size) {
-            block = &arena->data[i];
+    arena->limit = k_cast(char*) new_limit;
+#else  // !K_LINUX
+    assert(false && "Virtual memory arenas are not supported on this platform");
+#endif // K_LINUX
+}
+
+/// Retire the current block and make the next one current, with room for at least 'min_capacity' bytes.
+/// Blocks left over from a rewind are reused first; otherwise a fresh block is chained on the end.
+/// Allocations too big for a regular block get a block of their own, sized to fit.
+/// Previous blocks are never revisited for allocation, which keeps the fast path a single compare.
+static void k_arena_next_block(k_arena* arena, size_t min_capacity) {
+    if (arena->count > 0) {
+        k_arena_block* current = &arena->data[arena->current_block];
+        current->count_allocated = arena->cursor - current->data;
+#if K_ARENA_STATS
+        arena->stats.bytes_tail_waste += arena->limit - arena->cursor;
+#endif // K_ARENA_STATS
+    }
+
+    isize_t capacity = min_capacity > K_ARENA_BLOCK_SIZE ? k_cast(isize_t) min_capacity : K_ARENA_BLOCK_SIZE;
+    if (arena->count > 0 && arena->current_block + 1 < arena->count) {
+        arena->current_block++;
+
+        // Everything in a block past the current one was rewound away, so one too small can just be swapped for a bigger one.
+        k_arena_block* block = &arena->data[arena->current_block];
+        if (block->capacity < capacity) {
+            free(block->data);
+            block->data = malloc(k_cast(size_t) capacity);
+            assert(block->data != nullptr && "Buy more RAM lol");
+            block->capacity = capacity;
         }
+    } else {
+        char* block_memory = malloc(k_cast(size_t) capacity);
+        assert(block_memory != nullptr && "Buy more RAM lol");
+
+        k_da_push(arena, ((k_arena_block){ .data = block_memory, .capacity = capacity }));
+        arena->current_block = arena->count - 1;
     }
 
-    if (nullptr == block) {
-        char* block_memory = malloc(K_ARENA_BLOCK_SIZE);
-        k_da_push(arena, (k_arena_block){.data = block_memory});
-        assert(arena->count > 0);
-        block = &arena->data[arena->count - 1];
+    k_arena_block* block = &arena->data[arena->current_block];
+    block->count_allocated = 0;
+    arena->cursor = block->data;
+    arena->limit = block->data + block->capacity;
+}
+
+void* k_arena_alloc_aligned(k_arena* arena, size_t size, size_t align) {
+    assert(align > 0 && (align & (align - 1)) == 0);
+
+    // Even an empty allocation points into a block, so an arena without one yet has to get one first.
+    // The room left is compared rather than the end of the allocation, which a huge size could wrap around to below the limit.
+    uintptr_t cursor = k_cast(uintptr_t) arena->cursor;
+    uintptr_t limit = k_cast(uintptr_t) arena->limit;
+    uintptr_t result = k_arena_align_up(cursor, align);
+    if (arena->cursor == nullptr || result < cursor || result > limit || size > limit - result) {
+        if (result < cursor || size > UINTPTR_MAX - result || size > SIZE_MAX - align) {
+            k_arena_fatal(arena, "allocation size overflows the address space");
+        }
+
+        if (k_arena_is_virtual(arena)) {
+            k_arena_commit(arena, result + size);
+        } else {
+            // Leave room to align the allocation within the new block, wherever it lands.
+            k_arena_next_block(arena, size + align);
+            result = k_arena_align_up(k_cast(uintptr_t) arena->cursor, align);
+        }
     }
 
-    char* result = block->data + block->count_allocated;
-    memset(result, 0, aligned_size);
-    block->count_allocated += aligned_size;
+#if K_ARENA_STATS
+    arena->stats.allocation_count++;
+    k_arena_count_bytes(arena, k_cast(isize_t)(result - k_cast(uintptr_t) arena->cursor), k_cast(isize_t) size);
+#endif // K_ARENA_STATS
+
+    arena->cursor = k_cast(char*)(result + size);
+    return k_cast(void*) result;
+}
+
+void* k_arena_alloc_uninit(k_arena* arena, size_t size) {
+    return k_arena_alloc_aligned(arena, size, K_ARENA_ALIGN);
+}
+
+void* k_arena_alloc(k_arena* arena, size_t size) {
+    void* result = k_arena_alloc_aligned(arena, size, K_ARENA_ALIGN);
+    memset(result, 0, size);
     return result;
 }
+
+void* k_arena_alloc_array(k_arena* arena, size_t count, size_t element_size, size_t align) {
+    assert(element_size == 0 || count <= SIZE_MAX / element_size);
+    return k_arena_alloc_aligned(arena, count * element_size, align);
+}
+
+bool k_arena_try_extend(k_arena* arena, void* data, size_t old_size, size_t new_size) {
+    assert(data != nullptr);
+    assert(new_size >= old_size);
+
+    // Only the most recent allocation ends exactly at the cursor.
+    if (k_cast(char*) data + old_size != arena->cursor) {
+        return false;
+    }
+
+    // Compared as room left, like allocation, so a huge size cannot wrap around.
+    uintptr_t cursor = k_cast(uintptr_t) arena->cursor;
+    size_t growth = new_size - old_size;
+    if (growth > k_cast(uintptr_t) arena->limit - cursor) {
+        if (!k_arena_is_virtual(arena) || growth > k_cast(uintptr_t) arena->reserve_limit - cursor) {
+            return false;
+        }
+
+        k_arena_commit(arena, cursor + growth);
+    }
+
+#if K_ARENA_STATS
+    // Growing an allocation in place counts towards the bytes requested, but is not a new allocation.
+    k_arena_count_bytes(arena, 0, k_cast(isize_t)(new_size - old_size));
+#endif // K_ARENA_STATS
+
+    arena->cursor = k_cast(char*)(cursor + growth);
+    return true;
+}
+
+k_arena_checkpoint k_arena_mark(k_arena* arena) {
+    if (k_arena_is_virtual(arena)) {
+        return (k_arena_checkpoint){
+            .block_offset = arena->cursor - arena->reserve_base,
+            .bytes_in_use = arena->stats.bytes_in_use,
+        };
+    }
+
+    if (arena->count == 0) {
+        return (k_arena_checkpoint){0};
+    }
+
+    return (k_arena_checkpoint){
+        .block_index = arena->current_block,
+        .block_offset = arena->cursor - arena->data[arena->current_block].data,
+        .bytes_in_use = arena->stats.bytes_in_use,
+    };
+}
+
+void k_arena_rewind(k_arena* arena, k_arena_checkpoint checkpoint) {
+    if (k_arena_is_virtual(arena)) {
+        assert(checkpoint.block_index == 0);
+        assert(checkpoint.block_offset >= 0 && checkpoint.block_offset <= arena->cursor - arena->reserve_base);
+        arena->cursor = arena->reserve_base + checkpoint.block_offset;
+        arena->stats.bytes_in_use = checkpoint.bytes_in_use;
+        return;
+    }
+
+    // Nothing has been allocated at all, so there is nothing to roll back.
+    if (arena->count == 0) {
+        return;
+    }
+
+    assert(checkpoint.block_index >= 0 && checkpoint.block_index <= arena->current_block);
+    k_arena_block* block = &arena->data[checkpoint.block_index];
+    assert(checkpoint.block_offset >= 0 && checkpoint.block_offset <= block->capacity);
+
+    arena->current_block = checkpoint.block_index;
+    arena->cursor = block->data + checkpoint.block_offset;
+    arena->limit = block->data + block->capacity;
+    arena->stats.bytes_in_use = checkpoint.bytes_in_use;
+}
+
+void k_arena_trim(k_arena* arena) {
+#if defined(K_LINUX)
+    if (k_arena_is_virtual(arena)) {
+        // The pages stay committed, but their contents are dropped and they are zero-filled again on next touch.
+        char* discard_begin = k_cast(char*) k_arena_align_up(k_cast(uintptr_t) arena->cursor, k_cast(size_t) arena->commit_granularity);
+        if (discard_begin < arena->limit) {
+            k_discard madvise(discard_begin, k_cast(size_t)(arena->limit - discard_begin), MADV_DONTNEED);
+        }
+
+        return;
+    }
+#endif // K_LINUX
+
+    for (isize_t i = arena->current_block + 1; i < arena->count; i++) {
+        free(arena->data[i].data);
+    }
+
+    if (arena->count > arena->current_block + 1) {
+        arena->count = arena->current_block + 1;
+    }
+}
+
+void k_arena_set_tag(k_arena* arena, const char* tag) {
+    arena->tag = tag;
+}
+
+k_arena_stats k_arena_get_stats(k_arena* arena) {
+    k_arena_stats stats = arena->stats;
+    if (k_arena_is_virtual(arena)) {
+        stats.block_count = 0;
+        stats.bytes_committed = arena->limit - arena->reserve_base;
+    } else {
+        stats.block_count = arena->count;
+        stats.bytes_committed = 0;
+        for (isize_t i = 0; i < arena->count; i++) {
+            stats.bytes_committed += arena->data[i].capacity;
+        }
+    }
+
+    return stats;
+}
+
+void k_arena_print_stats(k_arena* arena, FILE* stream) {
+    k_arena_stats stats = k_arena_get_stats(arena);
+    fprintf(
+        stream,
+        "%-12s %10td %12td %12td %12td %12td %10td %10td %7td\n",
+        arena->tag != nullptr ? arena->tag : "<untagged>",
+        stats.allocation_count,
+        stats.bytes_requested,
+        stats.bytes_padding,
+        stats.bytes_in_use,
+        stats.bytes_peak,
+        stats.bytes_tail_waste,
+        stats.bytes_committed,
+        stats.block_count
+    );
+}
@@ -0,0 +1,51 @@
+#include <kos/kos.h>
+
+void* k_da_grow(k_arena* arena, void* data, isize_t count, isize_t* capacity, size_t element_size, isize_t min_capacity, bool exact) {
+    assert(capacity != nullptr);
+    assert(min_capacity > *capacity);
+
+    isize_t old_capacity = *capacity;
+    isize_t new_capacity = min_capacity;
+    if (!exact) {
+        isize_t grown_capacity = old_capacity == 0 ? K_DA_INIT_CAP : (old_capacity * K_DA_GROWTH_NUMERATOR) / K_DA_GROWTH_DENOMINATOR;
+        if (grown_capacity > new_capacity) {
+            new_capacity = grown_capacity;
+        }
+    }
+
+    size_t old_size = k_cast(size_t) old_capacity * element_size;
+    size_t new_size = k_cast(size_t) new_capacity * element_size;
+
+    if (arena == nullptr) {
+        data = realloc(data, new_size);
+    } else if (data == nullptr || !k_arena_try_extend(arena, data, old_size, new_size)) {
+        void* old_data = data;
+        data = k_arena_alloc_uninit(arena, new_size);
+        if (old_data != nullptr) {
+            memcpy(data, old_data, k_cast(size_t) count * element_size);
+        }
+    }
+
+    assert(data != nullptr && "Buy more RAM lol");
+    *capacity = new_capacity;
+    return data;
+}
+
+void* k_da_shrink(k_arena* arena, void* data, isize_t count, isize_t* capacity, size_t element_size) {
+    assert(capacity != nullptr);
+
+    if (arena != nullptr || *capacity == count) {
+        return data;
+    }
+
+    if (count == 0) {
+        free(data);
+        *capacity = 0;
+        return nullptr;
+    }
+
+    data = realloc(data, k_cast(size_t) count * element_size);
+    assert(data != nullptr && "Buy more RAM lol");
+    *capacity = count;
+    return data;
+}
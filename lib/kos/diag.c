@@ -84,6 +84,8 @@ void k_diag_emit(k_diag* diag, k_diag_data diag_data) {
     }
 
     diag->last_diag_was_ignored = false;
+    // Groups are a diagnostic and a handful of notes; the default dynamic array capacity would be wildly oversized.
+    k_da_reserve_exact(&diag->diag_group, 4);
     k_da_push(&diag->diag_group, diag_data);
 
     if (diag_data.level == K_DIAG_FATAL) {
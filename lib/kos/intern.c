@@ -0,0 +1,138 @@
+#include <kos/kos.h>
+
+#define K_INTERN_INITIAL_SLOT_COUNT 1024
+
+#define K_HASH_MULTIPLIER_A 0x9E3779B97F4A7C15ull
+#define K_HASH_MULTIPLIER_B 0xBF58476D1CE4E5B9ull
+
+static uint64_t k_hash_mix(uint64_t value) {
+    value ^= value >> 31;
+    value *= K_HASH_MULTIPLIER_B;
+    value ^= value >> 29;
+    return value;
+}
+
+uint64_t k_hash_bytes(const void* data, isize_t count) {
+    assert(count >= 0);
+
+    const unsigned char* bytes = data;
+    uint64_t hash = K_HASH_MULTIPLIER_A ^ k_cast(uint64_t) count;
+
+    while (count >= 8) {
+        uint64_t word;
+        memcpy(&word, bytes, 8);
+        hash = (hash ^ word) * K_HASH_MULTIPLIER_A;
+        hash ^= hash >> 32;
+        bytes += 8;
+        count -= 8;
+    }
+
+    // Identifiers are mostly shorter than a word, so the tail is folded into one more word rather than hashed byte by byte.
+    if (count > 0) {
+        uint64_t word = 0;
+        memcpy(&word, bytes, k_cast(size_t) count);
+        hash = (hash ^ word) * K_HASH_MULTIPLIER_A;
+    }
+
+    return k_hash_mix(hash);
+}
+
+static uint64_t k_intern_slot_tag(uint64_t hash) {
+    return hash & 0xFFFFFFFF00000000ull;
+}
+
+static uint64_t* k_intern_alloc_slots(k_intern_table* table, isize_t slot_count) {
+    return k_arena_alloc(table->entries.arena, k_cast(size_t) slot_count * sizeof(uint64_t));
+}
+
+/// Find the slot holding 'text', or the empty slot it would go in.
+static uint64_t* k_intern_probe(k_intern_table* table, k_string_view text, uint64_t hash) {
+    uint64_t tag = k_intern_slot_tag(hash);
+    isize_t mask = table->slot_count - 1;
+    isize_t index = k_cast(isize_t)(hash & k_cast(uint64_t) mask);
+
+    while (true) {
+        uint64_t* slot = &table->slots[index];
+        if (*slot == 0) {
+            return slot;
+        }
+
+        // The upper half of the hash rejects nearly every mismatch without touching the entry.
+        if ((*slot & 0xFFFFFFFF00000000ull) == tag) {
+            k_intern_entry* entry = &table->entries.data[*slot & 0xFFFFFFFFull];
+            if (entry->text.count == text.count && 0 == memcmp(entry->text.data, text.data, k_cast(size_t) text.count)) {
+                return slot;
+            }
+        }
+
+        index = (index + 1) & mask;
+    }
+}
+
+static void k_intern_grow(k_intern_table* table) {
+    isize_t new_slot_count = table->slot_count * 2;
+    uint64_t* new_slots = k_intern_alloc_slots(table, new_slot_count);
+    isize_t mask = new_slot_count - 1;
+
+    for (isize_t i = 1; i < table->entries.count; i++) {
+        uint64_t hash = table->entries.data[i].hash;
+        isize_t index = k_cast(isize_t)(hash & k_cast(uint64_t) mask);
+        while (new_slots[index] != 0) {
+            index = (index + 1) & mask;
+        }
+
+        new_slots[index] = k_intern_slot_tag(hash) | k_cast(uint64_t) i;
+    }
+
+    table->slots = new_slots;
+    table->slot_count = new_slot_count;
+}
+
+void k_intern_table_init(k_intern_table* table, k_arena* arena) {
+    *table = (k_intern_table){0};
+    table->entries.arena = arena;
+    table->slot_count = K_INTERN_INITIAL_SLOT_COUNT;
+    table->slots = k_intern_alloc_slots(table, table->slot_count);
+
+    k_da_push(&table->entries, ((k_intern_entry){ .text = K_SV_CONST("") }));
+}
+
+k_intern_id k_intern(k_intern_table* table, k_string_view text) {
+    // The empty string is entry 0 already, so it needs no spelling or slot of its own.
+    if (text.count == 0) {
+        return K_INTERN_ID_NONE;
+    }
+
+    uint64_t hash = k_hash_bytes(text.data, text.count);
+    uint64_t* slot = k_intern_probe(table, text, hash);
+    if (*slot != 0) {
+        return k_cast(k_intern_id)(*slot & 0xFFFFFFFFull);
+    }
+
+    assert(table->entries.count < UINT32_MAX && "Buy more RAM lol");
+
+    char* spelling = k_arena_alloc_aligned(table->entries.arena, k_cast(size_t) text.count + 1, 1);
+    memcpy(spelling, text.data, k_cast(size_t) text.count);
+    spelling[text.count] = 0;
+
+    k_intern_id id = k_cast(k_intern_id) table->entries.count;
+    k_da_push(&table->entries, ((k_intern_entry){ .text = k_sv(spelling, text.count), .hash = hash }));
+    *slot = k_intern_slot_tag(hash) | id;
+
+    // Keep the table at most half full so probe sequences stay short.
+    if (table->entries.count * 2 > table->slot_count) {
+        k_intern_grow(table);
+    }
+
+    return id;
+}
+
+k_intern_id k_intern_find(k_intern_table* table, k_string_view text) {
+    uint64_t* slot = k_intern_probe(table, text, k_hash_bytes(text.data, text.count));
+    return k_cast(k_intern_id)(*slot & 0xFFFFFFFFull);
+}
+
+k_string_view k_intern_get(k_intern_table* table, k_intern_id id) {
+    assert(id < table->entries.count);
+    return table->entries.data[id].text;
+}
@@ -0,0 +1,75 @@
+#include <kos/kos.h>
+
+/// Sizes up to this many bytes get a size class every K_POOL_SMALL_STEP bytes.
+#define K_POOL_SMALL_MAX  256
+#define K_POOL_SMALL_STEP 16
+#define K_POOL_SMALL_CLASS_COUNT (K_POOL_SMALL_MAX / K_POOL_SMALL_STEP)
+
+static_assert(K_POOL_SMALL_CLASS_COUNT + 8 == K_POOL_SIZE_CLASS_COUNT, "Size classes must cover 16 byte steps to 256 bytes, then powers of two to 64 KiB");
+
+/// Returns the size class 'size' belongs to and, through 'out_class_size', the number of bytes every object of that class occupies.
+static int k_pool_size_class(size_t size, size_t* out_class_size) {
+    assert(size > 0 && size <= K_POOL_MAX_SIZE);
+
+    if (size <= K_POOL_SMALL_MAX) {
+        int size_class = k_cast(int)((size + K_POOL_SMALL_STEP - 1) / K_POOL_SMALL_STEP) - 1;
+        *out_class_size = k_cast(size_t)(size_class + 1) * K_POOL_SMALL_STEP;
+        return size_class;
+    }
+
+    int size_class = K_POOL_SMALL_CLASS_COUNT;
+    size_t class_size = K_POOL_SMALL_MAX * 2;
+    while (class_size < size) {
+        class_size *= 2;
+        size_class++;
+    }
+
+    *out_class_size = class_size;
+    return size_class;
+}
+
+void k_pool_init(k_pool* pool, k_arena* arena) {
+    *pool = (k_pool){
+        .arena = arena,
+    };
+}
+
+void* k_pool_alloc(k_pool* pool, size_t size) {
+    assert(pool != nullptr);
+    assert(pool->arena != nullptr);
+
+    if (size > K_POOL_MAX_SIZE) {
+        return k_arena_alloc_uninit(pool->arena, size);
+    }
+
+    size_t class_size = 0;
+    int size_class = k_pool_size_class(size, &class_size);
+
+    k_pool_free_object* object = pool->free_lists[size_class];
+    if (object != nullptr) {
+        pool->free_lists[size_class] = object->next;
+        return object;
+    }
+
+    return k_arena_alloc_uninit(pool->arena, class_size);
+}
+
+void k_pool_free(k_pool* pool, void* data, size_t size) {
+    assert(pool != nullptr);
+
+    if (data == nullptr || size > K_POOL_MAX_SIZE) {
+        return;
+    }
+
+    size_t class_size = 0;
+    int size_class = k_pool_size_class(size, &class_size);
+
+    k_pool_free_object* object = data;
+    object->next = pool->free_lists[size_class];
+    pool->free_lists[size_class] = object;
+}
+
+void k_pool_reset(k_pool* pool) {
+    assert(pool != nullptr);
+    memset(pool->free_lists, 0, sizeof pool->free_lists);
+}
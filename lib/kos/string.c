@@ -59,7 +59,13 @@ void k_vsprintf(k_string* s, const char* format, va_list v) {
     int buffer_count = vsnprintf(NULL, 0, format, v1);
     va_end(v1);
 
-    k_da_ensure_capacity(s, s->count + buffer_count + 1);
+    // A fresh string is most often formatted exactly once (diagnostic messages, for example), so don't over-allocate it.
+    if (s->capacity == 0) {
+        k_da_reserve_exact(s, buffer_count + 1);
+    } else {
+        k_da_reserve(s, s->count + buffer_count + 1);
+    }
+
     va_list v2;
     va_copy(v2, v);
     int written = vsnprintf(s->data + s->count, k_cast(size_t) buffer_count + 1, format, v2);
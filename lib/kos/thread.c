@@ -0,0 +1,337 @@
+#if defined(__linux__)
+// sysconf and the pthread API are not exposed in strict ISO C modes otherwise.
+#    define _GNU_SOURCE
+#endif // __linux__
+
+#include <kos/kos.h>
+
+#if defined(K_WINDOWS)
+#    define WIN32_LEAN_AND_MEAN
+#    include <windows.h>
+#else // !K_WINDOWS
+#    include <pthread.h>
+#    include <unistd.h>
+#endif // K_WINDOWS
+
+///===--------------------------------------===///
+/// Atomics.
+///===--------------------------------------===///
+
+// Only the range of each worker is shared without the pool's lock, and that only ever needs a load, a store and a compare-exchange.
+#if defined(K_MSVC)
+static uint64_t k_atomic_load_u64(volatile uint64_t* value) {
+    return k_cast(uint64_t) InterlockedCompareExchange64(k_cast(volatile LONG64*) value, 0, 0);
+}
+
+static void k_atomic_store_u64(volatile uint64_t* value, uint64_t new_value) {
+    InterlockedExchange64(k_cast(volatile LONG64*) value, k_cast(LONG64) new_value);
+}
+
+static bool k_atomic_compare_exchange_u64(volatile uint64_t* value, uint64_t expected, uint64_t new_value) {
+    return k_cast(uint64_t) InterlockedCompareExchange64(k_cast(volatile LONG64*) value, k_cast(LONG64) new_value, k_cast(LONG64) expected) == expected;
+}
+#else // !K_MSVC
+static uint64_t k_atomic_load_u64(volatile uint64_t* value) {
+    return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+}
+
+static void k_atomic_store_u64(volatile uint64_t* value, uint64_t new_value) {
+    __atomic_store_n(value, new_value, __ATOMIC_RELEASE);
+}
+
+static bool k_atomic_compare_exchange_u64(volatile uint64_t* value, uint64_t expected, uint64_t new_value) {
+    return __atomic_compare_exchange_n(value, &expected, new_value, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+#endif // K_MSVC
+
+///===--------------------------------------===///
+/// Thread pool.
+///===--------------------------------------===///
+
+/// The tasks a worker has yet to run, as a range of task indices packed into one word so that its owner and thieves can both claim from it with a single compare-exchange.
+/// The owner takes tasks one at a time from the front, and thieves take the back half.
+typedef struct k_thread_pool_worker {
+    volatile uint64_t range;
+    /// Keep each worker's range on a cache line of its own, so claiming tasks does not bounce lines between cores.
+    char padding[64 - sizeof(uint64_t)];
+} k_thread_pool_worker;
+
+struct k_thread_pool {
+    isize_t worker_count;
+    /// One per worker; worker 0 is whichever thread calls k_thread_pool_run.
+    k_thread_pool_worker* workers;
+
+#if defined(K_WINDOWS)
+    HANDLE* threads;
+    SRWLOCK lock;
+    CONDITION_VARIABLE start_condition;
+    CONDITION_VARIABLE done_condition;
+#else  // !K_WINDOWS
+    pthread_t* threads;
+    pthread_mutex_t lock;
+    pthread_cond_t start_condition;
+    pthread_cond_t done_condition;
+#endif // K_WINDOWS
+
+    // Everything below is guarded by the lock.
+
+    /// Bumped once per k_thread_pool_run, to wake the background workers.
+    uint64_t generation;
+    /// The number of background workers still busy with the current run.
+    isize_t running_count;
+    bool is_shutting_down;
+
+    k_task_callback callback;
+    void* userdata;
+};
+
+/// What a background worker thread is started with.
+typedef struct k_thread_pool_start {
+    k_thread_pool* pool;
+    isize_t worker_index;
+} k_thread_pool_start;
+
+static uint64_t k_task_range_pack(uint32_t begin, uint32_t end) {
+    return k_cast(uint64_t) begin | k_cast(uint64_t) end << 32;
+}
+
+static void k_thread_pool_lock(k_thread_pool* pool) {
+#if defined(K_WINDOWS)
+    AcquireSRWLockExclusive(&pool->lock);
+#else  // !K_WINDOWS
+    pthread_mutex_lock(&pool->lock);
+#endif // K_WINDOWS
+}
+
+static void k_thread_pool_unlock(k_thread_pool* pool) {
+#if defined(K_WINDOWS)
+    ReleaseSRWLockExclusive(&pool->lock);
+#else  // !K_WINDOWS
+    pthread_mutex_unlock(&pool->lock);
+#endif // K_WINDOWS
+}
+
+#if defined(K_WINDOWS)
+#    define k_thread_pool_wait(Pool, Condition)   SleepConditionVariableSRW(&(Pool)->Condition, &(Pool)->lock, INFINITE, 0)
+#    define k_thread_pool_wake(Pool, Condition)   WakeConditionVariable(&(Pool)->Condition)
+#    define k_thread_pool_wake_all(Pool, Condition) WakeAllConditionVariable(&(Pool)->Condition)
+#else // !K_WINDOWS
+#    define k_thread_pool_wait(Pool, Condition)   pthread_cond_wait(&(Pool)->Condition, &(Pool)->lock)
+#    define k_thread_pool_wake(Pool, Condition)   pthread_cond_signal(&(Pool)->Condition)
+#    define k_thread_pool_wake_all(Pool, Condition) pthread_cond_broadcast(&(Pool)->Condition)
+#endif // K_WINDOWS
+
+/// Claim the next task from the front of a worker's own range.
+static bool k_thread_pool_take(k_thread_pool_worker* worker, isize_t* out_task_index) {
+    for (;;) {
+        uint64_t range = k_atomic_load_u64(&worker->range);
+        uint32_t begin = k_cast(uint32_t) range;
+        uint32_t end = k_cast(uint32_t)(range >> 32);
+        if (begin >= end) {
+            return false;
+        }
+
+        if (k_atomic_compare_exchange_u64(&worker->range, range, k_task_range_pack(begin + 1, end))) {
+            *out_task_index = begin;
+            return true;
+        }
+    }
+}
+
+/// Move the back half of some other worker's remaining tasks into this worker's own range, which must be empty.
+/// Returns false once every other worker has run out too.
+static bool k_thread_pool_steal(k_thread_pool* pool, isize_t worker_index) {
+    // Victims are tried in a fixed order starting after the thief, so thieves spread out over the other workers.
+    for (isize_t i = 1; i < pool->worker_count; i++) {
+        k_thread_pool_worker* victim = &pool->workers[(worker_index + i) % pool->worker_count];
+        for (;;) {
+            uint64_t range = k_atomic_load_u64(&victim->range);
+            uint32_t begin = k_cast(uint32_t) range;
+            uint32_t end = k_cast(uint32_t)(range >> 32);
+            if (begin >= end) {
+                break;
+            }
+
+            uint32_t middle = begin + (end - begin) / 2;
+            if (k_atomic_compare_exchange_u64(&victim->range, range, k_task_range_pack(begin, middle))) {
+                k_atomic_store_u64(&pool->workers[worker_index].range, k_task_range_pack(middle, end));
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+/// Run tasks as worker 'worker_index' until there are none left to run or steal.
+static void k_thread_pool_work(k_thread_pool* pool, isize_t worker_index) {
+    k_thread_pool_worker* worker = &pool->workers[worker_index];
+    for (;;) {
+        isize_t task_index;
+        if (k_thread_pool_take(worker, &task_index)) {
+            pool->callback(pool->userdata, task_index, worker_index);
+        } else if (!k_thread_pool_steal(pool, worker_index)) {
+            return;
+        }
+    }
+}
+
+#if defined(K_WINDOWS)
+static DWORD WINAPI k_thread_pool_thread_main(void* argument) {
+#else  // !K_WINDOWS
+static void* k_thread_pool_thread_main(void* argument) {
+#endif // K_WINDOWS
+    k_thread_pool_start start = *k_cast(k_thread_pool_start*) argument;
+    free(argument);
+
+    k_thread_pool* pool = start.pool;
+    uint64_t seen_generation = 0;
+
+    for (;;) {
+        k_thread_pool_lock(pool);
+        while (pool->generation == seen_generation && !pool->is_shutting_down) {
+            k_thread_pool_wait(pool, start_condition);
+        }
+
+        bool is_shutting_down = pool->is_shutting_down;
+        seen_generation = pool->generation;
+        k_thread_pool_unlock(pool);
+
+        if (is_shutting_down) {
+            break;
+        }
+
+        k_thread_pool_work(pool, start.worker_index);
+
+        k_thread_pool_lock(pool);
+        if (--pool->running_count == 0) {
+            k_thread_pool_wake(pool, done_condition);
+        }
+        k_thread_pool_unlock(pool);
+    }
+
+#if defined(K_WINDOWS)
+    return 0;
+#else  // !K_WINDOWS
+    return nullptr;
+#endif // K_WINDOWS
+}
+
+isize_t k_processor_count(void) {
+#if defined(K_WINDOWS)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? k_cast(isize_t) info.dwNumberOfProcessors : 1;
+#else  // !K_WINDOWS
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? k_cast(isize_t) count : 1;
+#endif // K_WINDOWS
+}
+
+k_thread_pool* k_thread_pool_create(isize_t worker_count) {
+    if (worker_count <= 0) {
+        worker_count = k_processor_count();
+    }
+
+    k_thread_pool* pool = calloc(1, sizeof(k_thread_pool));
+    assert(pool != nullptr && "Buy more RAM lol");
+
+    pool->worker_count = worker_count;
+    pool->workers = calloc(k_cast(size_t) worker_count, sizeof(k_thread_pool_worker));
+    pool->threads = calloc(k_cast(size_t) worker_count, sizeof(*pool->threads));
+    assert(pool->workers != nullptr && pool->threads != nullptr && "Buy more RAM lol");
+
+#if defined(K_WINDOWS)
+    InitializeSRWLock(&pool->lock);
+    InitializeConditionVariable(&pool->start_condition);
+    InitializeConditionVariable(&pool->done_condition);
+#else  // !K_WINDOWS
+    pthread_mutex_init(&pool->lock, nullptr);
+    pthread_cond_init(&pool->start_condition, nullptr);
+    pthread_cond_init(&pool->done_condition, nullptr);
+#endif // K_WINDOWS
+
+    // The thread calling k_thread_pool_run is worker 0, so only the rest get threads of their own.
+    for (isize_t i = 1; i < worker_count; i++) {
+        k_thread_pool_start* start = malloc(sizeof(k_thread_pool_start));
+        assert(start != nullptr && "Buy more RAM lol");
+        *start = (k_thread_pool_start){ .pool = pool, .worker_index = i };
+
+#if defined(K_WINDOWS)
+        pool->threads[i] = CreateThread(nullptr, 0, k_thread_pool_thread_main, start, 0, nullptr);
+        assert(pool->threads[i] != nullptr && "Could not start a thread pool worker");
+#else  // !K_WINDOWS
+        int create_result = pthread_create(&pool->threads[i], nullptr, k_thread_pool_thread_main, start);
+        assert(create_result == 0 && "Could not start a thread pool worker");
+        k_discard create_result;
+#endif // K_WINDOWS
+    }
+
+    return pool;
+}
+
+void k_thread_pool_destroy(k_thread_pool* pool) {
+    if (pool == nullptr) return;
+
+    k_thread_pool_lock(pool);
+    pool->is_shutting_down = true;
+    k_thread_pool_wake_all(pool, start_condition);
+    k_thread_pool_unlock(pool);
+
+    for (isize_t i = 1; i < pool->worker_count; i++) {
+#if defined(K_WINDOWS)
+        WaitForSingleObject(pool->threads[i], INFINITE);
+        CloseHandle(pool->threads[i]);
+#else  // !K_WINDOWS
+        pthread_join(pool->threads[i], nullptr);
+#endif // K_WINDOWS
+    }
+
+#if !defined(K_WINDOWS)
+    pthread_cond_destroy(&pool->done_condition);
+    pthread_cond_destroy(&pool->start_condition);
+    pthread_mutex_destroy(&pool->lock);
+#endif // !K_WINDOWS
+
+    free(pool->threads);
+    free(pool->workers);
+    free(pool);
+}
+
+isize_t k_thread_pool_get_worker_count(k_thread_pool* pool) {
+    assert(pool != nullptr);
+    return pool->worker_count;
+}
+
+void k_thread_pool_run(k_thread_pool* pool, isize_t task_count, k_task_callback callback, void* userdata) {
+    assert(pool != nullptr);
+    assert(callback != nullptr);
+    assert(task_count >= 0 && task_count <= UINT32_MAX && "Too many tasks for one run of a thread pool");
+
+    if (task_count == 0) {
+        return;
+    }
+
+    // Every worker starts with an even share of consecutive tasks; stealing evens out whatever imbalance is left.
+    for (isize_t i = 0; i < pool->worker_count; i++) {
+        uint32_t begin = k_cast(uint32_t)(task_count * i / pool->worker_count);
+        uint32_t end = k_cast(uint32_t)(task_count * (i + 1) / pool->worker_count);
+        k_atomic_store_u64(&pool->workers[i].range, k_task_range_pack(begin, end));
+    }
+
+    k_thread_pool_lock(pool);
+    pool->callback = callback;
+    pool->userdata = userdata;
+    pool->running_count = pool->worker_count - 1;
+    pool->generation++;
+    k_thread_pool_wake_all(pool, start_condition);
+    k_thread_pool_unlock(pool);
+
+    k_thread_pool_work(pool, 0);
+
+    k_thread_pool_lock(pool);
+    while (pool->running_count > 0) {
+        k_thread_pool_wait(pool, done_condition);
+    }
+    k_thread_pool_unlock(pool);
+}
@@ -1,5 +1,85 @@
 #include <kos/kos.h>
 
+#if defined(K_SSE2)
+#    include <emmintrin.h>
+#endif // K_SSE2
+
+#if defined(K_AVX2)
+#    include <immintrin.h>
+#endif // K_AVX2
+
+/// The UTF-8 decoding automaton has nine states: accept, reject, one or two continuation bytes left, and one for each lead whose second byte has a restricted range (E0, ED, F0, F1..F3 and F4).
+/// Each state is stored as a multiple of 6, the bit offset of its next state within a transition row, so a step is a single shift and mask with no further table lookup depending on the state.
+#define K_UTF8_ACCEPT 0
+#define K_UTF8_REJECT 6
+
+/// Maps each byte to one of 12 classes; bytes in a class are interchangeable to the automaton.
+/// Leads whose second byte has a restricted range (E0, ED, F0 and F4) get classes of their own, as do the three sub-ranges of continuation bytes those restrictions cut at.
+static const uint8_t k_utf8_byte_class[256] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 00..1F
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 20..3F
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 40..5F
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 60..7F
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, // 80..9F
+    7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, // A0..BF
+    8, 8, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, // C0..DF
+    10, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 4, 3, 3, 11, 6, 6, 6, 5, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, // E0..FF
+};
+
+/// For each byte class, the next state from every state, packed 6 bits per state in the order accept, reject, one left, two left, E0, ED, F0, F1..F3, F4.
+static const uint64_t k_utf8_transitions[12] = {
+    0x0006186186186180ull, // 00..7F
+    0x0012486306300186ull, // 80..8F
+    0x000618618618618Cull, // C2..DF
+    0x0006186186186192ull, // E1..EC, EE..EF
+    0x000618618618619Eull, // ED
+    0x00061861861861B0ull, // F4
+    0x00061861861861AAull, // F1..F3
+    0x000649218C300186ull, // A0..BF
+    0x0006186186186186ull, // C0..C1, F5..FF
+    0x0006492306300186ull, // 90..9F
+    0x0006186186186198ull, // E0
+    0x00061861861861A4ull, // F0
+};
+
+/// The length of the sequence each byte class starts, or 0 for classes which cannot start one.
+static const uint8_t k_utf8_sequence_length[12] = {1, 0, 2, 3, 3, 4, 4, 0, 0, 0, 3, 4};
+
+/// The payload bits of a lead byte, by the length of the sequence it starts.
+static const uint8_t k_utf8_lead_mask[5] = {0, 0x7F, 0x1F, 0x0F, 0x07};
+
+static uint32_t k_utf8_step(uint32_t state, unsigned char byte) {
+    return k_cast(uint32_t)(k_utf8_transitions[k_utf8_byte_class[byte]] >> state) & 63;
+}
+
+static isize_t k_utf8_validate_sequence(const unsigned char* data, isize_t count, isize_t offset, k_unicode_decode_result* out_error, isize_t* out_error_length);
+
+/// Runs the automaton over the sequence at 'offset', which must start with a non-ASCII byte.
+/// Returns its length if it is well-formed, otherwise 0; the automaton only knows that the sequence is ill-formed, so k_utf8_validate_sequence works out why and where it stops, off the hot path.
+static inline isize_t k_utf8_decode_sequence(const unsigned char* data, isize_t count, isize_t offset, int32_t* out_codepoint) {
+    isize_t length = k_utf8_sequence_length[k_utf8_byte_class[data[offset]]];
+
+    if (length != 0 && length <= count - offset) {
+        // The reject state is absorbing, so there is no need to stop early: step through every byte the lead asks for and check where the automaton ended up once.
+        const unsigned char* sequence = data + offset;
+        uint32_t state = k_utf8_step(K_UTF8_ACCEPT, sequence[0]);
+        int32_t codepoint = sequence[0] & k_utf8_lead_mask[length];
+        switch (length) {
+            case 4: state = k_utf8_step(state, *++sequence), codepoint = (codepoint << 6) | (*sequence & 0x3F); [[fallthrough]];
+            case 3: state = k_utf8_step(state, *++sequence), codepoint = (codepoint << 6) | (*sequence & 0x3F); [[fallthrough]];
+            case 2: state = k_utf8_step(state, *++sequence), codepoint = (codepoint << 6) | (*sequence & 0x3F); [[fallthrough]];
+            default: break;
+        }
+
+        if (state == K_UTF8_ACCEPT) {
+            *out_codepoint = codepoint;
+            return length;
+        }
+    }
+
+    return 0;
+}
+
 k_unicode_decode_result k_utf8_decode(const char* data, isize_t data_count, isize_t offset, int32_t* out_codepoint, isize_t* out_stride) {
     if (data == nullptr || data_count <= 0) {
         return K_UNICODE_END_OF_DATA;
@@ -9,59 +89,207 @@ k_unicode_decode_result k_utf8_decode(const char* data, isize_t data_count, isiz
         return K_UNICODE_OUT_OF_RANGE;
     }
 
-    char c = data[offset];
-
-    // 0yyyzzzz is a single byte
-    if ((c & 0x80) == 0) {
-        if (out_codepoint != nullptr) *out_codepoint = c;
+    const unsigned char* bytes = k_cast(const unsigned char*) data;
+    if (bytes[offset] < 0x80) {
+        if (out_codepoint != nullptr) *out_codepoint = bytes[offset];
         if (out_stride != nullptr) *out_stride = 1;
         return K_UNICODE_SUCCESS;
     }
 
-    // 110xxxyy 10yyzzzz is two bytes
-    if ((c & 0xE0) == 0xC0) {
-        if (data_count < 2) return K_UNICODE_END_OF_DATA;
+    int32_t codepoint = 0;
+    isize_t stride = k_utf8_decode_sequence(bytes, data_count, offset, &codepoint);
+    if (stride == 0) {
+        k_unicode_decode_result error = K_UNICODE_SUCCESS;
+        isize_t error_length = 0;
+        k_utf8_validate_sequence(bytes, data_count, offset, &error, &error_length);
+        if (out_stride != nullptr) *out_stride = error_length;
+        return error;
+    }
 
-        char c1 = data[offset + 1];
-        if ((c1 & 0xC0) != 0x80) return K_UNICODE_INVALID_CONTINUE_BYTE;
+    if (out_codepoint != nullptr) *out_codepoint = codepoint;
+    if (out_stride != nullptr) *out_stride = stride;
+    return K_UNICODE_SUCCESS;
+}
 
-        if (out_codepoint != nullptr) *out_codepoint = ((c & 0x1F) << 6) | (c1 & 0x3F);
-        if (out_stride != nullptr) *out_stride = 2;
-        return K_UNICODE_SUCCESS;
+isize_t k_utf8_decode_many(const char* data, isize_t data_count, isize_t* offset, int32_t* out_codepoints, isize_t* out_offsets, isize_t max_codepoints) {
+    assert(offset != nullptr);
+    assert(*offset >= 0 && *offset <= data_count);
+    assert(out_codepoints != nullptr);
+
+    const unsigned char* bytes = k_cast(const unsigned char*) data;
+    isize_t position = *offset;
+    isize_t decoded_count = 0;
+
+    while (decoded_count < max_codepoints && position < data_count) {
+        if (bytes[position] < 0x80) {
+            // Widen whole runs of ASCII at once; this loop has no data-dependent branches, so compilers vectorize it.
+            isize_t ascii_limit = data_count - position < max_codepoints - decoded_count ? data_count - position : max_codepoints - decoded_count;
+            isize_t ascii_count = k_ascii_prefix_length(data + position, ascii_limit);
+            for (isize_t i = 0; i < ascii_count; i++) {
+                out_codepoints[decoded_count + i] = bytes[position + i];
+                if (out_offsets != nullptr) out_offsets[decoded_count + i] = position + i;
+            }
+
+            decoded_count += ascii_count;
+            position += ascii_count;
+            continue;
+        }
+
+        int32_t codepoint = 0;
+        isize_t stride = k_utf8_decode_sequence(bytes, data_count, position, &codepoint);
+        if (stride == 0) {
+            k_unicode_decode_result error;
+            k_utf8_validate_sequence(bytes, data_count, position, &error, &stride);
+            codepoint = K_UNICODE_REPLACEMENT_CHARACTER;
+        }
+
+        out_codepoints[decoded_count] = codepoint;
+        if (out_offsets != nullptr) out_offsets[decoded_count] = position;
+        decoded_count++;
+        position += stride;
     }
 
-    // 1110wwww 10xxxxyy 10yyzzzz is three bytes
-    if ((c & 0xF0) == 0xE0) {
-        if (data_count < 3) return K_UNICODE_END_OF_DATA;
+    *offset = position;
+    return decoded_count;
+}
 
-        char c1 = data[offset + 1];
-        if ((c1 & 0xC0) != 0x80) return K_UNICODE_INVALID_CONTINUE_BYTE;
+isize_t k_ascii_prefix_length(const char* data, isize_t count) {
+    isize_t offset = 0;
 
-        char c2 = data[offset + 2];
-        if ((c2 & 0xC0) != 0x80) return K_UNICODE_INVALID_CONTINUE_BYTE;
+#if defined(K_AVX2)
+    for (; offset + 32 <= count; offset += 32) {
+        __m256i chunk = _mm256_loadu_si256(k_cast(const __m256i*)(data + offset));
+        uint32_t high_bits = k_cast(uint32_t) _mm256_movemask_epi8(chunk);
+        if (high_bits != 0) {
+            return offset + k_count_trailing_zeros(high_bits);
+        }
+    }
+#endif // K_AVX2
 
-        if (out_codepoint != nullptr) *out_codepoint = ((c & 0x0F) << 12) | ((c1 & 0x3F) << 6) | (c2 & 0x3F);
-        if (out_stride != nullptr) *out_stride = 3;
-        return K_UNICODE_SUCCESS;
+#if defined(K_SSE2)
+    for (; offset + 16 <= count; offset += 16) {
+        __m128i chunk = _mm_loadu_si128(k_cast(const __m128i*)(data + offset));
+        uint32_t high_bits = k_cast(uint32_t) _mm_movemask_epi8(chunk);
+        if (high_bits != 0) {
+            return offset + k_count_trailing_zeros(high_bits);
+        }
     }
+#else  // !K_SSE2
+    for (; offset + 8 <= count; offset += 8) {
+        uint64_t word;
+        memcpy(&word, data + offset, 8);
+        if (0 != (word & 0x8080808080808080ull)) {
+            break;
+        }
+    }
+#endif // K_SSE2
 
-    // 11110uvv 10vvwwww 10xxxxyy 10yyzzzz is four bytes
-    if ((c & 0xF8) == 0xF0) {
-        if (data_count < 4) return K_UNICODE_END_OF_DATA;
+    while (offset < count && 0 == (data[offset] & 0x80)) {
+        offset++;
+    }
 
-        char c1 = data[offset + 1];
-        if ((c1 & 0xC0) != 0x80) return K_UNICODE_INVALID_CONTINUE_BYTE;
+    return offset;
+}
 
-        char c2 = data[offset + 2];
-        if ((c2 & 0xC0) != 0x80) return K_UNICODE_INVALID_CONTINUE_BYTE;
+/// Validate the multi-byte sequence starting at 'offset', following table 3-7 of the Unicode standard.
+/// Returns the length of the sequence if it is well-formed, otherwise 0 with the reason and the length of its maximal ill-formed prefix.
+static isize_t k_utf8_validate_sequence(const unsigned char* data, isize_t count, isize_t offset, k_unicode_decode_result* out_error, isize_t* out_error_length) {
+    unsigned char lead = data[offset];
 
-        char c3 = data[offset + 3];
-        if ((c3 & 0xC0) != 0x80) return K_UNICODE_INVALID_CONTINUE_BYTE;
+    isize_t length;
+    // The valid range of the second byte, which is narrower than 0x80..0xBF for the leads which could otherwise encode overlongs, surrogates or values past U+10FFFF.
+    unsigned char second_min = 0x80, second_max = 0xBF;
+    k_unicode_decode_result second_error = K_UNICODE_INVALID_CONTINUE_BYTE;
 
-        if (out_codepoint != nullptr) *out_codepoint = ((c & 0x07) << 18) | ((c1 & 0x3F) << 12) | ((c2 & 0x3F) << 6) | (c3 & 0x3F);
-        if (out_stride != nullptr) *out_stride = 4;
-        return K_UNICODE_SUCCESS;
+    if (lead >= 0xC2 && lead <= 0xDF) {
+        length = 2;
+    } else if (lead >= 0xE0 && lead <= 0xEF) {
+        length = 3;
+        if (lead == 0xE0) second_min = 0xA0, second_error = K_UNICODE_OVERLONG_ENCODING;
+        if (lead == 0xED) second_max = 0x9F, second_error = K_UNICODE_INVALID_CODEPOINT;
+    } else if (lead >= 0xF0 && lead <= 0xF4) {
+        length = 4;
+        if (lead == 0xF0) second_min = 0x90, second_error = K_UNICODE_OVERLONG_ENCODING;
+        if (lead == 0xF4) second_max = 0x8F, second_error = K_UNICODE_INVALID_CODEPOINT;
+    } else {
+        *out_error = lead == 0xC0 || lead == 0xC1 ? K_UNICODE_OVERLONG_ENCODING : (lead >= 0xF5 ? K_UNICODE_INVALID_CODEPOINT : K_UNICODE_INVALID_START_BYTE);
+        *out_error_length = 1;
+        return 0;
+    }
+
+    for (isize_t i = 1; i < length; i++) {
+        if (offset + i >= count) {
+            *out_error = K_UNICODE_END_OF_DATA;
+            *out_error_length = i;
+            return 0;
+        }
+
+        unsigned char byte = data[offset + i];
+        bool in_range = i == 1 ? (byte >= second_min && byte <= second_max) : (byte >= 0x80 && byte <= 0xBF);
+        if (!in_range) {
+            *out_error = i == 1 && byte >= 0x80 && byte <= 0xBF ? second_error : K_UNICODE_INVALID_CONTINUE_BYTE;
+            *out_error_length = i;
+            return 0;
+        }
+    }
+
+    return length;
+}
+
+isize_t k_utf8_validate(const char* data, isize_t count, isize_t offset, k_unicode_decode_result* out_error, isize_t* out_error_length) {
+    assert(offset >= 0 && offset <= count);
+
+    k_unicode_decode_result error = K_UNICODE_SUCCESS;
+    isize_t error_length = 0;
+
+    while (offset < count) {
+        offset += k_ascii_prefix_length(data + offset, count - offset);
+        if (offset >= count) {
+            break;
+        }
+
+        int32_t codepoint;
+        isize_t length = k_utf8_decode_sequence(k_cast(const unsigned char*) data, count, offset, &codepoint);
+        if (length == 0) {
+            k_utf8_validate_sequence(k_cast(const unsigned char*) data, count, offset, &error, &error_length);
+            if (out_error != nullptr) *out_error = error;
+            if (out_error_length != nullptr) *out_error_length = error_length;
+            return offset;
+        }
+
+        offset += length;
+    }
+
+    return count;
+}
+
+#include "unicode-xid.inc"
+
+/// Returns the trie leaf holding 'codepoint', which must be below K_UNICODE_XID_TRIE_LIMIT: XID_Start in its low half and XID_Continue in its high half.
+static uint64_t k_unicode_xid_leaf(int32_t codepoint) {
+    uint32_t block = k_unicode_xid_pages[codepoint / K_UNICODE_XID_PAGE_SIZE];
+    uint32_t leaf = k_unicode_xid_blocks[block * K_UNICODE_XID_BLOCK_SIZE + (codepoint / K_UNICODE_XID_LEAF_SIZE) % K_UNICODE_XID_BLOCK_SIZE];
+    return k_unicode_xid_leaves[leaf];
+}
+
+bool k_unicode_is_xid_start(int32_t codepoint) {
+    if (codepoint < 0 || codepoint >= K_UNICODE_XID_TRIE_LIMIT) {
+        return false;
+    }
+
+    return 0 != (k_unicode_xid_leaf(codepoint) >> (codepoint % K_UNICODE_XID_LEAF_SIZE) & 1);
+}
+
+bool k_unicode_is_xid_continue(int32_t codepoint) {
+    if (codepoint >= 0 && codepoint < K_UNICODE_XID_TRIE_LIMIT) {
+        return 0 != (k_unicode_xid_leaf(codepoint) >> (32 + codepoint % K_UNICODE_XID_LEAF_SIZE) & 1);
+    }
+
+    for (isize_t i = 0; i < k_cast(isize_t)(sizeof k_unicode_xid_continue_high_ranges / sizeof k_unicode_xid_continue_high_ranges[0]); i++) {
+        if (codepoint >= k_unicode_xid_continue_high_ranges[i][0] && codepoint <= k_unicode_xid_continue_high_ranges[i][1]) {
+            return true;
+        }
     }
 
-    return K_UNICODE_INVALID_START_BYTE;
+    return false;
 }
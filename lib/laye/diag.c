@@ -1,12 +1,33 @@
 #include <laye/diag.h>
 
-#define KDSRC(Source, Location) \
-    ((k_diag_source){ .name = (Source)->name, .text = (Source)->text, .use_byte_offset = true, .byte_offset = (Location) })
+/// Decode 'location' into the diagnostic source information k_diag wants.
+static k_diag_source ly_diag_source(ch_context* context, ch_location location) {
+    ch_decoded_location decoded = ch_context_decode_location(context, location);
+    if (decoded.source == nullptr) {
+        return (k_diag_source){0};
+    }
 
-CHOIR_API void ly_err_invalid_character(k_diag* diag, ch_source* source, isize_t location) {
-    k_diag_emitsf(diag, K_DIAG_ERROR, KDSRC(source, location), "Invalid character in source text.");
+    return (k_diag_source){ .name = decoded.source->name, .text = decoded.source->text, .line = decoded.line, .column = decoded.column };
 }
 
-CHOIR_API void ly_err_unclosed_comment(k_diag* diag, ch_source* source, isize_t location) {
-    k_diag_emitsf(diag, K_DIAG_ERROR, KDSRC(source, location), "Unclosed delimited comment.");
+CHOIR_API void ly_err_invalid_character(ch_context* context, ch_location location) {
+    k_diag_emitsf(context->diag, K_DIAG_ERROR, ly_diag_source(context, location), "Invalid character in source text.");
+}
+
+CHOIR_API void ly_err_invalid_utf8(ch_context* context, ch_location location, k_unicode_decode_result reason) {
+    const char* detail;
+    switch (reason) {
+        default: detail = "malformed sequence"; break;
+        case K_UNICODE_END_OF_DATA: detail = "sequence truncated by the end of the file"; break;
+        case K_UNICODE_INVALID_START_BYTE: detail = "unexpected continuation byte"; break;
+        case K_UNICODE_INVALID_CONTINUE_BYTE: detail = "sequence truncated by a non-continuation byte"; break;
+        case K_UNICODE_OVERLONG_ENCODING: detail = "overlong encoding"; break;
+        case K_UNICODE_INVALID_CODEPOINT: detail = "encodes a surrogate or a value past U+10FFFF"; break;
+    }
+
+    k_diag_emitsf(context->diag, K_DIAG_ERROR, ly_diag_source(context, location), "Invalid UTF-8 in source text: %s.", detail);
+}
+
+CHOIR_API void ly_err_unclosed_comment(ch_context* context, ch_location location) {
+    k_diag_emitsf(context->diag, K_DIAG_ERROR, ly_diag_source(context, location), "Unclosed delimited comment.");
 }
@@ -1,45 +1,133 @@
 #include <laye/core.h>
 #include <laye/diag.h>
 
-static bool ly_lexer_peek_raw(ly_lexer* lexer, isize_t peek_position, int32_t* out_codepoint, isize_t* out_stride);
-static int32_t ly_lexer_peek(ly_lexer* lexer, int ahead);
-
-static bool ly_lexer_is_c(ly_lexer* lexer) {
-    assert(lexer != nullptr);
-    return 0 != (lexer->mode & LY_LEXMODE_C);
+#if defined(K_SSE2)
+#    include <emmintrin.h>
+#endif // K_SSE2
+
+static void ly_lexer_seek(ly_lexer* lexer, isize_t position);
+
+static_assert(LY_LEXMODE_REJECTED_BRANCH < (1 << LY_LEXER_MODE_BITS), "Every lexer mode must fit on the mode stack");
+static_assert(LY_LEXER_MODE_STACK_DEPTH * LY_LEXER_MODE_BITS <= 64, "The mode stack must fit in its 64 bits");
+
+#define LY_IDENTIFIER_START    (1 << 0)
+#define LY_IDENTIFIER_CONTINUE (1 << 1)
+
+/// Identifier classes of every byte, so that the common case stays a single table lookup; bytes 80..FF are left zero and go to the Unicode XID tables.
+/// Accepting '$' in identifiers is an extension, as it is in most C compilers.
+static const uint8_t ly_identifier_class[256] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 00..0F
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 10..1F
+    0, 0, 0, 0, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 20..2F
+    2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 0, 0, 0, 0, 0, 0, // 30..3F
+    0, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, // 40..4F
+    3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 0, 0, 0, 0, 3, // 50..5F
+    0, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, // 60..6F
+    3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 0, 0, 0, 0, 0, // 70..7F
+};
+
+static bool ly_is_identifier_start(int32_t c) {
+    return c < 0x80 ? 0 != (ly_identifier_class[c] & LY_IDENTIFIER_START) : k_unicode_is_xid_start(c);
 }
 
-static bool ly_lexer_is_laye(ly_lexer* lexer) {
-    assert(lexer != nullptr);
-    return 0 != (lexer->mode & LY_LEXMODE_LAYE);
-}
+/// What a token starting with a given byte is, as far as that one byte can tell in the language being lexed.
+typedef enum ly_byte_class {
+    /// Non-ASCII, which may still start an identifier, and bytes no token starts with.
+    LY_BYTE_OTHER,
+    /// NUL, which ends the source like the end of the text does.
+    LY_BYTE_END,
+    /// A newline left over by trivia, which only happens within a preprocessing directive.
+    LY_BYTE_NEWLINE,
+    LY_BYTE_IDENTIFIER,
+    /// A digit in C, which starts a pp-number.
+    LY_BYTE_DIGIT,
+    /// '.' in C, which starts a pp-number if a digit follows and a punctuator otherwise.
+    LY_BYTE_DOT,
+    LY_BYTE_PUNCTUATOR,
+    /// A digit in Laye, which starts a number.
+    LY_BYTE_LAYE_DIGIT,
+
+    LY_BYTE_CLASS_COUNT,
+} ly_byte_class;
+
+/// The class of every byte, given the classes of '.' and the digits, which are all the languages disagree on; bytes 80..FF are left zero, which is LY_BYTE_OTHER.
+/// A punctuator missing from here is still recognized through LY_BYTE_OTHER, only more slowly.
+#define LY_BYTE_CLASSES(Dot, Digit)                                                                          \
+    {                                                                                                        \
+        1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 0, 0, 0, 0, 0, /* 00..0F */                                         \
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, /* 10..1F */                                         \
+        0, 6, 0, 6, 3, 6, 6, 0, 6, 6, 6, 6, 6, 6, Dot, 6, /* 20..2F */                                       \
+        Digit, Digit, Digit, Digit, Digit, Digit, Digit, Digit, Digit, Digit, 6, 6, 6, 6, 6, 6, /* 30..3F */ \
+        0, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, /* 40..4F */                                         \
+        3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 6, 0, 6, 6, 3, /* 50..5F */                                         \
+        0, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, /* 60..6F */                                         \
+        3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 6, 6, 6, 6, 0, /* 70..7F */                                         \
+    }
 
-static bool ly_lexer_suppress_diags(ly_lexer* lexer) {
-    assert(lexer != nullptr);
-    return 0 != (lexer->mode & LY_LEXMODE_REJECTED_BRANCH);
+static const uint8_t ly_c_byte_classes[256] = LY_BYTE_CLASSES(LY_BYTE_DOT, LY_BYTE_DIGIT);
+static const uint8_t ly_laye_byte_classes[256] = LY_BYTE_CLASSES(LY_BYTE_PUNCTUATOR, LY_BYTE_LAYE_DIGIT);
+
+/// A punctuator in the generated maximal munch tables.
+/// Its spelling is a little-endian word of up to four bytes, matched against the upcoming bytes under 'mask'.
+typedef struct ly_punctuator {
+    uint32_t bytes;
+    uint32_t mask;
+    uint16_t kind;
+    uint16_t key;
+    uint8_t length;
+} ly_punctuator;
+
+/// The punctuators starting with one byte, as a range of ly_punctuators ordered longest first.
+typedef struct ly_punctuator_candidates {
+    uint8_t first;
+    uint8_t count;
+} ly_punctuator_candidates;
+
+static_assert(LY_TOKEN_KIND_COUNT <= UINT16_MAX, "Token kinds must fit in a punctuator");
+
+// Generated by nob from <laye/tokens.h>; see src/gen_ly_punctuators.c.
+#include "laye-punctuators.inc"
+
+/// Puts the lexer in 'mode' and works out everything lexing depends on it for, so that nothing tests mode bits while lexing.
+static void ly_lexer_set_mode(ly_lexer* lexer, ly_lexer_mode mode) {
+    assert((0 != (mode & LY_LEXMODE_LAYE)) != (0 != (mode & LY_LEXMODE_C)) && "A lexer mode must be exactly one of Laye or C");
+    bool is_laye = 0 != (mode & LY_LEXMODE_LAYE);
+
+    lexer->mode = mode;
+    lexer->byte_classes = is_laye ? ly_laye_byte_classes : ly_c_byte_classes;
+    lexer->punctuator_keys = is_laye ? LY_TKKEY_LAYE : LY_TKKEY_C;
+    lexer->keyword_table = is_laye ? lexer->laye_keyword_table : lexer->c_keyword_table;
+    lexer->nests_block_comments = is_laye;
+    lexer->newlines_are_trivia = 0 == (mode & LY_LEXMODE_DIRECTIVE);
+    lexer->reports_diagnostics = 0 == (mode & LY_LEXMODE_REJECTED_BRANCH);
 }
 
 CHOIR_API void ly_lexer_init(ly_lexer* lexer, ch_context* context, ch_source* source, ly_lexer_mode mode) {
     if (lexer == nullptr) return;
 
+    ly_normalized_source normalized;
+    ly_source_normalize(&normalized, context, source, 0 != (mode & LY_LEXMODE_C));
+    ly_lexer_init_normalized(lexer, context, &normalized, mode);
+}
+
+CHOIR_API void ly_lexer_init_normalized(ly_lexer* lexer, ch_context* context, const ly_normalized_source* normalized, ly_lexer_mode mode) {
+    if (lexer == nullptr) return;
+    assert(normalized != nullptr);
+
     *lexer = (ly_lexer){
         .context = context,
-        .source = source,
+        .source = normalized->source,
+        .normalized = *normalized,
         .is_at_start_of_line = true,
-        .mode = mode,
-        // Initialize tracking for __FILE__ and __LINE__.
-        .current_file_name = source->name,
-        .current_line_number = 1,
+        // Initialize tracking for __FILE__; lines come from the source's line table instead of being counted.
+        .current_file_name = normalized->source->name,
+        // Chosen once here rather than on every mode change, so a table installed with ly_lexer_set_keyword_table survives pushes and pops.
+        .c_keyword_table = context->c_keyword_table != nullptr ? context->c_keyword_table : ly_keyword_table_get_builtin(LY_TKKEY_C23),
+        .laye_keyword_table = ly_keyword_table_get_builtin(LY_TKKEY_LAYE),
     };
 
-    if (!ly_lexer_peek_raw(lexer, 0, &lexer->current_codepoint, &lexer->current_stride)) {
-        lexer->current_codepoint = 0;
-        lexer->current_stride = 0;
-    }
-}
-
-static bool ly_lexer_is_at_end(ly_lexer* lexer) {
-    return lexer->current_codepoint == 0 || lexer->current_position >= lexer->source->text.count;
+    ly_lexer_set_mode(lexer, mode);
+    ly_lexer_seek(lexer, 0);
 }
 
 static bool ly_lexer_peek_raw(ly_lexer* lexer, isize_t peek_position, int32_t* out_codepoint, isize_t* out_stride) {
@@ -48,53 +136,22 @@ static bool ly_lexer_peek_raw(ly_lexer* lexer, isize_t peek_position, int32_t* o
     // TODO(local): Consider if supporting other encodings is worth doing.
     // If it is, we'll have a custom character decoder replace this hard-coded call to our UTF-8 decoder.
 
-    const char* text_data = lexer->source->text.data;
-    isize_t text_count = lexer->source->text.count;
-
-    int32_t codepoint = 0;
-    isize_t stride = 0;
+    // Newline sequences and line splices were already dealt with by ly_source_normalize, so this is only decoding.
+    const char* text_data = lexer->normalized.text.data;
+    isize_t text_count = lexer->normalized.text.count;
 
-    k_unicode_decode_result decode_result = k_utf8_decode(text_data, text_count, peek_position, &codepoint, &stride);
-    if (decode_result != K_UNICODE_SUCCESS) {
+    if (peek_position < 0 || peek_position >= text_count) {
         return false;
     }
 
-    peek_position += stride;
+    int32_t codepoint = k_cast(unsigned char) text_data[peek_position];
+    isize_t stride = 1;
 
-    if (peek_position < text_count) {
-        int32_t ahead_codepoint = 0;
-        isize_t ahead_stride = 0;
-
-        // The sequence '\n\r' should be handled as a single '\n'.
-        if (codepoint == '\n' && K_UNICODE_SUCCESS == k_utf8_decode(text_data, text_count, peek_position, &ahead_codepoint, &ahead_stride) && ahead_codepoint == '\r') {
-            stride += ahead_stride;
-            peek_position += ahead_stride;
-        }
-
-        // The character '\n' and sequence '\r\n' should be handled as a single '\n'.
-        if (codepoint == '\r') {
-            codepoint = '\n';
-            if (K_UNICODE_SUCCESS == k_utf8_decode(text_data, text_count, peek_position, &ahead_codepoint, &ahead_stride) && ahead_codepoint == '\n') {
-                stride += ahead_stride;
-                peek_position += ahead_stride;
-            }
-        }
-
-        // TODO(local): since escaping a newline turns it into a space at this level, is this something the preprocessor thinks increases the current line number?
-        // I don't think it does, but we need to test it and check the standard.
-
-        // The sequences '\\\n', '\\\r', '\\\n\r' and '\\\r\n' should all be handled as a single ' '.
-        if (0 != (lexer->mode & LY_LEXMODE_C) && codepoint == '\\' && K_UNICODE_SUCCESS == k_utf8_decode(text_data, text_count, peek_position, &ahead_codepoint, &ahead_stride) && (ahead_codepoint == '\r' || ahead_codepoint == '\n')) {
-            codepoint = ' ';
-            stride += ahead_stride;
-            peek_position += ahead_stride;
-
-            int32_t other_newline_char = ahead_codepoint == '\r' ? '\n' : '\r';
-            if (K_UNICODE_SUCCESS == k_utf8_decode(text_data, text_count, peek_position, &ahead_codepoint, &ahead_stride) && ahead_codepoint == other_newline_char) {
-                stride += ahead_stride;
-                peek_position += ahead_stride;
-            }
-        }
+    // ASCII is by far the common case and needs no decoding; only bytes with the high bit set go through the decoder.
+    // Ill-formed sequences were already reported by ly_source_normalize, so here they just become U+FFFD a byte at a time.
+    if (codepoint >= 0x80 && K_UNICODE_SUCCESS != k_utf8_decode(text_data, text_count, peek_position, &codepoint, &stride)) {
+        codepoint = K_UNICODE_REPLACEMENT_CHARACTER;
+        stride = 1;
     }
 
     if (out_codepoint != nullptr) *out_codepoint = codepoint;
@@ -103,28 +160,32 @@ static bool ly_lexer_peek_raw(ly_lexer* lexer, isize_t peek_position, int32_t* o
     return true;
 }
 
-static int32_t ly_lexer_peek(ly_lexer* lexer, int ahead) {
+/// Moves the lexer to 'position' and stages the character there, as ly_lexer_next_character does.
+/// The lexer itself scans bytes, and only syncs the staged character like this once it is done with a token or with trivia.
+static void ly_lexer_seek(ly_lexer* lexer, isize_t position) {
     assert(lexer != nullptr);
-    k_assert(lexer->context->diag, ahead >= 0, "Lexer does not support peeking backwards.");
 
-    // we only have to do on-the-fly decoding for ahead > 0.
-    if (ahead == 0) {
-        return lexer->current_codepoint;
+    lexer->current_position = position;
+    if (!ly_lexer_peek_raw(lexer, position, &lexer->current_codepoint, &lexer->current_stride)) {
+        lexer->current_codepoint = 0;
+        lexer->current_stride = 0;
     }
+}
 
-    int32_t codepoint = 0;
-    isize_t stride = 0;
-
-    isize_t peek_position = lexer->current_position + lexer->current_stride;
-    for (int i = 0; i < ahead; i++) {
-        if (!ly_lexer_peek_raw(lexer, peek_position, &codepoint, &stride)) {
-            return 0;
-        }
+/// Returns the spelling of the source text in [begin_position, end_position).
+/// Normalized text outlives every token read from it and has no line splices left, so this is always a view straight into it.
+static k_string_view ly_lexer_spelling(ly_lexer* lexer, isize_t begin_position, isize_t end_position) {
+    return k_sv(lexer->normalized.text.data + begin_position, end_position - begin_position);
+}
 
-        peek_position += stride;
+/// Returns the location of a lexer position in the original source text, for ranges and diagnostics.
+static ch_location ly_lexer_location(ly_lexer* lexer, isize_t position) {
+    // Most sources need no normalizing at all, and then every position already is an offset in the original text.
+    if (lexer->normalized.offsets.count == 0) {
+        return lexer->source->location + k_cast(ch_location) position;
     }
 
-    return codepoint;
+    return lexer->source->location + k_cast(ch_location) ly_source_original_offset(&lexer->normalized, position);
 }
 
 CHOIR_API void ly_lexer_next_character(ly_lexer* lexer) {
@@ -137,385 +198,502 @@ CHOIR_API void ly_lexer_next_character(ly_lexer* lexer) {
     }
 
     if (lexer->current_codepoint == '\n') {
-        lexer->current_line_number++;
         lexer->is_at_start_of_line = true;
     }
 
-    lexer->current_position += lexer->current_stride;
-    if (!ly_lexer_peek_raw(lexer, lexer->current_position, &lexer->current_codepoint, &lexer->current_stride)) {
-        lexer->current_codepoint = 0;
-        lexer->current_stride = 0;
+    ly_lexer_seek(lexer, lexer->current_position + lexer->current_stride);
+}
+
+/// Returns the position of the newline ending the line 'position' is on, or the end of the text if that line is the last.
+/// memchr is already vectorized by every C library worth using, so line comments lean on it.
+static isize_t ly_lexer_end_of_line(ly_lexer* lexer, isize_t position) {
+    const char* text = lexer->normalized.text.data;
+    isize_t count = lexer->normalized.text.count;
+
+    const char* newline = memchr(text + position, '\n', k_cast(size_t)(count - position));
+    return newline == nullptr ? count : k_cast(isize_t)(newline - text);
+}
+
+static bool ly_is_blank(char c, bool skip_newlines) {
+    return c == ' ' || c == '\t' || c == '\v' || (skip_newlines && c == '\n');
+}
+
+/// Returns the position of the first byte at or after 'position' which is not white space.
+/// Newlines only count as white space if 'skip_newlines' is set.
+static isize_t ly_lexer_skip_blanks(ly_lexer* lexer, isize_t position, bool skip_newlines) {
+    const char* text = lexer->normalized.text.data;
+    isize_t count = lexer->normalized.text.count;
+
+    // Most runs of white space are a single space between two tokens, which is not worth a vector load.
+    if (position < count && !ly_is_blank(text[position], skip_newlines)) {
+        return position;
+    }
+
+#if defined(K_SSE2)
+    const __m128i spaces = _mm_set1_epi8(' ');
+    const __m128i tabs = _mm_set1_epi8('\t');
+    const __m128i vertical_tabs = _mm_set1_epi8('\v');
+    const __m128i newlines = _mm_set1_epi8('\n');
+
+    for (; position + 16 <= count; position += 16) {
+        __m128i chunk = _mm_loadu_si128(k_cast(const __m128i*)(text + position));
+        __m128i blanks = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, spaces), _mm_cmpeq_epi8(chunk, tabs)), _mm_cmpeq_epi8(chunk, vertical_tabs));
+        if (skip_newlines) blanks = _mm_or_si128(blanks, _mm_cmpeq_epi8(chunk, newlines));
+
+        uint32_t other_bits = ~k_cast(uint32_t) _mm_movemask_epi8(blanks) & 0xFFFF;
+        if (other_bits != 0) {
+            return position + k_count_trailing_zeros(other_bits);
+        }
+    }
+#endif // K_SSE2
+
+    while (position < count && ly_is_blank(text[position], skip_newlines)) {
+        position++;
+    }
+
+    return position;
+}
+
+/// Returns the position of the first '*' at or after 'position', or the first '/' as well if 'nests', or the end of the text if there is none.
+/// These are the only bytes which can end or open a block comment.
+static isize_t ly_lexer_find_comment_delimiter(ly_lexer* lexer, isize_t position, bool nests) {
+    const char* text = lexer->normalized.text.data;
+    isize_t count = lexer->normalized.text.count;
+
+#if defined(K_SSE2)
+    const __m128i stars = _mm_set1_epi8('*');
+    // Without nesting, searching for '*' twice is cheaper than branching on 'nests' in the loop.
+    const __m128i slashes = _mm_set1_epi8(nests ? '/' : '*');
+
+    for (; position + 16 <= count; position += 16) {
+        __m128i chunk = _mm_loadu_si128(k_cast(const __m128i*)(text + position));
+        uint32_t delimiter_bits = k_cast(uint32_t) _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, stars), _mm_cmpeq_epi8(chunk, slashes)));
+        if (delimiter_bits != 0) {
+            return position + k_count_trailing_zeros(delimiter_bits);
+        }
+    }
+#endif // K_SSE2
+
+    for (; position < count; position++) {
+        char c = text[position];
+        if (c == '*' || (nests && c == '/')) break;
     }
+
+    return position;
 }
 
-static void ly_lexer_read_relevant_trivia(ly_lexer* lexer, bool is_leading) {
+/// Skips the trivia starting at 'position' and returns the position after it.
+/// Only whether the next token starts a line is updated here; the caller moves the lexer once it is done with the token the trivia belongs to.
+static isize_t ly_lexer_read_relevant_trivia(ly_lexer* lexer, isize_t position, bool is_leading) {
     assert(lexer != nullptr);
 
-    ly_lexer_mode mode = lexer->mode;
-    isize_t begin_position = lexer->current_position;
+    const char* text = lexer->normalized.text.data;
+    isize_t count = lexer->normalized.text.count;
+
+    // Newlines are only trivia before a token, and not at all within a directive, where the one ending it is lexed as a token.
+    bool skip_newlines = is_leading && lexer->newlines_are_trivia;
+    isize_t trivia_position = position;
 
-    while (lexer->current_codepoint != 0) {
-        int32_t c = lexer->current_codepoint;
-        switch (c) {
+    while (position < count) {
+        switch (text[position]) {
             default: goto done_reading_trivia;
 
             case '#': {
-                if (lexer->current_position == 0 && ly_lexer_peek(lexer, 1) == '!') {
-                    ly_lexer_next_character(lexer); // omnom '#'
-                    ly_lexer_next_character(lexer); // omnom '!'
+                if (position == 0 && count > 1 && text[1] == '!') {
                     // TODO(local): store the text of this shebang and throw it in a trivia, it'll be important eventually.
-                    while (lexer->current_codepoint != 0 && lexer->current_codepoint != '\n') {
-                        ly_lexer_next_character(lexer); // omnom anything that isn't the end of line/file
-                    }
+                    position = ly_lexer_end_of_line(lexer, 2);
                 } else goto done_reading_trivia;
             } break;
 
             case '/': {
-                if (ly_lexer_peek(lexer, 1) == '/') {
-                    ly_lexer_next_character(lexer); // omnom '/'
-                    ly_lexer_next_character(lexer); // omnom '/'
+                char next = position + 1 < count ? text[position + 1] : 0;
+                if (next == '/') {
                     // TODO(local): store the text of this line comment and throw it in a trivia, it'll be important eventually.
-                    while (lexer->current_codepoint != 0 && lexer->current_codepoint != '\n') {
-                        ly_lexer_next_character(lexer); // omnom anything that isn't the end of line/file
-                    }
+                    position = ly_lexer_end_of_line(lexer, position + 2);
                     // newlines will end the trailing trivia list
                     if (!is_leading) goto done_reading_trivia;
-                } else if (ly_lexer_peek(lexer, 1) == '*') {
-                    ly_lexer_next_character(lexer); // omnom '/'
-                    ly_lexer_next_character(lexer); // omnom '*'
-                    // TODO(local): store the text of this line comment and throw it in a trivia, it'll be important eventually.
+                } else if (next == '*') {
+                    // TODO(local): store the text of this block comment and throw it in a trivia, it'll be important eventually.
+                    isize_t comment_position = position;
+                    position += 2;
+
+                    // Laye block comments nest; C ones end at the first "*/".
+                    bool nests = lexer->nests_block_comments;
                     int comment_nesting = 1;
-                    int32_t prev_codepoint = 0;
-                    while (lexer->current_codepoint != 0 && comment_nesting > 0) {
-                        int32_t c = lexer->current_codepoint;
-                        if (c == '/' && prev_codepoint == '*') {
-                            prev_codepoint = 0;
+                    while (comment_nesting > 0) {
+                        position = ly_lexer_find_comment_delimiter(lexer, position, nests);
+                        // A delimiter in the last byte cannot be half of a pair, so the comment is unclosed either way.
+                        if (position + 1 >= count) {
+                            position = count;
+                            break;
+                        }
+
+                        char c = text[position];
+                        next = text[position + 1];
+                        if (c == '*' && next == '/') {
+                            position += 2;
                             comment_nesting--;
-                        } else if (0 != (mode & LY_LEXMODE_LAYE) && c == '*' && prev_codepoint == '/') {
-                            prev_codepoint = 0;
+                        } else if (nests && c == '/' && next == '*') {
+                            position += 2;
                             comment_nesting++;
+                        } else {
+                            position++;
                         }
-
-                        prev_codepoint = c;
-                        ly_lexer_next_character(lexer); // omnom anything until we get to the end of comment/file
                     }
 
                     if (comment_nesting > 0) {
-                        if (!ly_lexer_suppress_diags(lexer))
-                            ly_err_unclosed_comment(lexer->context->diag, lexer->source, begin_position);
+                        if (lexer->reports_diagnostics)
+                            ly_err_unclosed_comment(lexer->context, ly_lexer_location(lexer, comment_position));
                     }
                 } else goto done_reading_trivia;
             } break;
 
-            case ' ':
-            case '\t':
-            case '\v':
-            is_white_space_trivia: {
-                ly_lexer_next_character(lexer); // omnom whitespace
+            case '\n': {
+                // newlines will end the trailing trivia list, and a directive is ended by one
+                if (!skip_newlines) goto done_reading_trivia;
+                position = ly_lexer_skip_blanks(lexer, position + 1, skip_newlines); // omnom whitespace
             } break;
 
-            case '\n': {
-                // newlines will end the trailing trivia list
-                if (!is_leading) goto done_reading_trivia;
-                if (0 != (lexer->mode & LY_LEXMODE_DIRECTIVE)) {
-                    goto done_reading_trivia; // this will be lexed as a directive end token
-                } ly_lexer_next_character(lexer); // omnom whitespace
+            case ' ':
+            case '\t':
+            case '\v': {
+                position = ly_lexer_skip_blanks(lexer, position + 1, skip_newlines); // omnom whitespace
             } break;
         }
     }
 
 done_reading_trivia:;
+    // Trivia rarely spans lines; looking for a newline in it once is cheaper than tracking them while skipping it.
+    if (position != trivia_position && nullptr != memchr(text + trivia_position, '\n', k_cast(size_t)(position - trivia_position))) {
+        lexer->is_at_start_of_line = true;
+    }
+
     // TODO(local): When we're ready to *store* trivia, put it in a list and return it here.
-    return;
+    return position;
 }
 
-static bool ly_lexer_try_advance(ly_lexer* lexer, int32_t codepoint) {
-    assert(lexer != nullptr);
-    if (lexer->current_codepoint == codepoint) {
-        ly_lexer_next_character(lexer);
-        return true;
+/// Returns the longest punctuator starting at 'position' which the lexer's language has, and its length in 'out_length'.
+/// Returns LY_TK_INVALID and a length of 0 if there is none.
+static ly_token_kind ly_lexer_match_punctuator(ly_lexer* lexer, isize_t position, isize_t* out_length) {
+    const char* text = lexer->normalized.text.data;
+    isize_t count = lexer->normalized.text.count;
+
+    // Bytes past the end of the text are left zero, which no punctuator is spelled with.
+    uint32_t upcoming = 0;
+    for (isize_t i = 0; i < LY_PUNCTUATOR_MAX_LENGTH && position + i < count; i++) {
+        upcoming |= k_cast(uint32_t) k_cast(unsigned char) text[position + i] << (i * 8);
     }
 
-    return false;
+    unsigned char first = k_cast(unsigned char) text[position];
+    if (first < 0x80) {
+        ly_token_key keys = lexer->punctuator_keys;
+        ly_punctuator_candidates candidates = ly_punctuator_candidates_by_byte[first];
+        for (int i = 0; i < candidates.count; i++) {
+            const ly_punctuator* punctuator = &ly_punctuators[candidates.first + i];
+            if ((upcoming & punctuator->mask) == punctuator->bytes && 0 != (punctuator->key & keys)) {
+                *out_length = punctuator->length;
+                return k_cast(ly_token_kind) punctuator->kind;
+            }
+        }
+    }
+
+    *out_length = 0;
+    return LY_TK_INVALID;
 }
 
-CHOIR_API ly_token ly_lexer_read_pp_token(ly_lexer* lexer) {
-    assert(lexer != nullptr);
+/// Returns the end of the identifier characters starting at 'position', which may be 'position' itself if there are none.
+static isize_t ly_lexer_scan_identifier(ly_lexer* lexer, isize_t position) {
+    const char* text = lexer->normalized.text.data;
+    isize_t count = lexer->normalized.text.count;
+
+    for (;;) {
+        while (position < count && 0 != (ly_identifier_class[k_cast(unsigned char) text[position]] & LY_IDENTIFIER_CONTINUE)) {
+            position++;
+        }
 
-    isize_t begin_position = lexer->current_position;
+        if (position >= count || k_cast(unsigned char) text[position] < 0x80) {
+            return position;
+        }
+
+        int32_t codepoint = 0;
+        isize_t stride = 0;
+        if (K_UNICODE_SUCCESS != k_utf8_decode(text, count, position, &codepoint, &stride) || !k_unicode_is_xid_continue(codepoint)) {
+            return position;
+        }
+
+        position += stride;
+    }
+}
+
+/// Returns the end of the C pp-number whose first character ends at 'position'.
+static isize_t ly_lexer_scan_pp_number(ly_lexer* lexer, isize_t position) {
+    const char* text = lexer->normalized.text.data;
+    isize_t count = lexer->normalized.text.count;
+
+    while (position < count) {
+        char c = text[position];
+        char next = position + 1 < count ? text[position + 1] : 0;
+
+        if (c == '.') {
+            position++;
+        } else if (c == '\'' && next >= '0' && next <= '9') {
+            position += 2; // omnom single quote and digit
+        } else if ((c == 'e' || c == 'E' || c == 'p' || c == 'P') && (next == '+' || next == '-')) {
+            position += 2; // omnom exponent character and sign
+        } else {
+            isize_t identifier_end = ly_lexer_scan_identifier(lexer, position);
+            if (identifier_end == position) break;
+            position = identifier_end;
+        }
+    }
+
+    return position;
+}
+
+/// Lexes the token at 'start_position' along with the trivia around it into 'out_token', and returns the position after its trailing trivia.
+/// The lexer is not moved; callers either seek to the returned position or, when lexing a whole source, just carry on from it.
+static isize_t ly_lexer_lex_token(ly_lexer* lexer, isize_t start_position, ly_token* out_token) {
     // TODO(local): Store the trivia in a trivia list for later.
-    ly_lexer_read_relevant_trivia(lexer, true);
+    isize_t begin_position = ly_lexer_read_relevant_trivia(lexer, start_position, true);
 
-    ly_lexer_mode mode = lexer->mode;
     ly_token token = {
         .kind = LY_TK_INVALID,
         .at_start_of_line = lexer->is_at_start_of_line,
-        .has_white_space_before = begin_position != lexer->current_position,
+        .has_white_space_before = begin_position != start_position,
     };
 
-    begin_position = lexer->current_position;
-
-    int32_t c = lexer->current_codepoint;
-    int32_t c_stride = lexer->current_stride;
-    ly_lexer_next_character(lexer);
-
-    switch (c) {
-        default: {
-            if (!ly_lexer_suppress_diags(lexer))
-                ly_err_invalid_character(lexer->context->diag, lexer->source, begin_position);
-        } break;
-
-        case '\0': {
-            token.kind = LY_TK_END_OF_FILE;
-        } break;
-
-        case '\n': {
-            ch_asserts(lexer->context->diag, 0 != (lexer->mode & LY_LEXMODE_DIRECTIVE), lexer->source, begin_position, "The newline character is white space unless within a preprocessing directive.");
-            token.kind = LY_TK_PP_END_OF_DIRECTIVE;
-        } break;
-
-        case '#': {
-            if (ly_lexer_is_c(lexer) && ly_lexer_try_advance(lexer, '#')) {
-                token.kind = LY_TK_HASH_HASH;
-            } else if (ly_lexer_is_laye(lexer) && ly_lexer_try_advance(lexer, '[')) {
-                token.kind = LY_TK_HASH_SQUARE;
-            } else token.kind = LY_TK_HASH;
-        } break;
-
-        case '(': token.kind = LY_TK_OPEN_PAREN; break;
-        case ')': token.kind = LY_TK_CLOSE_PAREN; break;
-        case '[': token.kind = LY_TK_OPEN_SQUARE; break;
-        case ']': token.kind = LY_TK_CLOSE_SQUARE; break;
-        case '{': token.kind = LY_TK_OPEN_CURLY; break;
-        case '}': token.kind = LY_TK_CLOSE_CURLY; break;
-
-        case ',': token.kind = LY_TK_COMMA; break;
-        case ';': token.kind = LY_TK_SEMI_COLON; break;
-
-        case '.': {
-            if (ly_lexer_is_c(lexer) && lexer->current_codepoint >= '0' && lexer->current_codepoint <= '9') {
-                goto lex_pp_number;
-            } else if (ly_lexer_is_c(lexer) && ly_lexer_peek(lexer, 0) == '.' && ly_lexer_peek(lexer, 1) == '.') {
-                ly_lexer_next_character(lexer); // omnom '.' 2
-                ly_lexer_next_character(lexer); // omnom '.' 3
-                token.kind = LY_TK_DOT_DOT_DOT;
-            } else if (ly_lexer_is_laye(lexer) && ly_lexer_try_advance(lexer, '.')) {
-                if (ly_lexer_try_advance(lexer, '=')) {
-                    token.kind = LY_TK_DOT_DOT_EQUAL;
-                } else token.kind = LY_TK_DOT_DOT;
-            } else token.kind = LY_TK_DOT;
-        } break;
-
-        case ':': {
-            if (ly_lexer_try_advance(lexer, ':')) {
-                token.kind = LY_TK_COLON_COLON;
-            } else token.kind = LY_TK_COLON;
-        } break;
-
-        case '=': {
-            if (ly_lexer_try_advance(lexer, '=')) {
-                token.kind = LY_TK_EQUAL_EQUAL;
-            } else if (ly_lexer_is_laye(lexer) && ly_lexer_try_advance(lexer, '>')) {
-                token.kind = LY_TK_EQUAL_GREATER;
-            } else token.kind = LY_TK_EQUAL;
-        } break;
-
-        case '!': {
-            if (ly_lexer_try_advance(lexer, '=')) {
-                token.kind = LY_TK_BANG_EQUAL;
-            } else token.kind = LY_TK_BANG;
-        } break;
-
-        case '<': {
-            if (ly_lexer_try_advance(lexer, '=')) {
-                if (ly_lexer_is_laye(lexer) && ly_lexer_try_advance(lexer, '>')) {
-                    token.kind = LY_TK_LESS_EQUAL_GREATER;
-                } token.kind = LY_TK_LESS_EQUAL;
-            } else if (ly_lexer_try_advance(lexer, '<')) {
-                if (ly_lexer_try_advance(lexer, '=')) {
-                    token.kind = LY_TK_LESS_LESS_EQUAL;
-                } token.kind = LY_TK_LESS_LESS;
-            } else token.kind = LY_TK_LESS;
-        } break;
-
-        case '>': {
-            if (ly_lexer_try_advance(lexer, '=')) {
-                token.kind = LY_TK_GREATER_EQUAL;
-            } else if (ly_lexer_try_advance(lexer, '>')) {
-                if (ly_lexer_try_advance(lexer, '=')) {
-                    token.kind = LY_TK_GREATER_GREATER_EQUAL;
-                } token.kind = LY_TK_GREATER_GREATER;
-            } else token.kind = LY_TK_GREATER;
-        } break;
-
-        case '+': {
-            if (ly_lexer_try_advance(lexer, '=')) {
-                token.kind = LY_TK_PLUS_EQUAL;
-            } else if (ly_lexer_try_advance(lexer, '+')) {
-                token.kind = LY_TK_PLUS_PLUS;
-            } else token.kind = LY_TK_PLUS;
-        } break;
-
-        case '-': {
-            if (ly_lexer_try_advance(lexer, '=')) {
-                token.kind = LY_TK_MINUS_EQUAL;
-            } else if (ly_lexer_try_advance(lexer, '-')) {
-                token.kind = LY_TK_MINUS_MINUS;
-            } else if (ly_lexer_try_advance(lexer, '>')) {
-                token.kind = LY_TK_MINUS_GREATER;
-            } else token.kind = LY_TK_MINUS;
-        } break;
-
-        case '*': {
-            if (ly_lexer_try_advance(lexer, '=')) {
-                token.kind = LY_TK_STAR_EQUAL;
-            } else token.kind = LY_TK_STAR;
-        } break;
-
-        case '/': {
-            if (ly_lexer_try_advance(lexer, '=')) {
-                token.kind = LY_TK_SLASH_EQUAL;
-            } else token.kind = LY_TK_SLASH;
-        } break;
-
-        case '%': {
-            // TODO(local): If we decide to support trigraphs, and they're enabled here, lex them.
-            if (ly_lexer_try_advance(lexer, '=')) {
-                token.kind = LY_TK_PERCENT_EQUAL;
-            } else token.kind = LY_TK_PERCENT;
-        } break;
-
-        case '^': {
-            if (ly_lexer_try_advance(lexer, '=')) {
-                token.kind = LY_TK_CARET_EQUAL;
-            } else token.kind = LY_TK_CARET;
-        } break;
-
-        case '~': {
-            if (ly_lexer_is_laye(lexer) && ly_lexer_try_advance(lexer, '=')) {
-                token.kind = LY_TK_TILDE_EQUAL;
-            } else token.kind = LY_TK_TILDE;
-        } break;
-
-        case '&': {
-            if (ly_lexer_try_advance(lexer, '=')) {
-                token.kind = LY_TK_AMPERSAND_EQUAL;
-            } else if (ly_lexer_try_advance(lexer, '&')) {
-                token.kind = LY_TK_AMPERSAND_AMPERSAND;
-            } else token.kind = LY_TK_AMPERSAND;
-        } break;
-
-        case '|': {
-            if (ly_lexer_try_advance(lexer, '=')) {
-                token.kind = LY_TK_PIPE_EQUAL;
-            } else if (ly_lexer_try_advance(lexer, '|')) {
-                token.kind = LY_TK_PIPE_PIPE;
-            } else token.kind = LY_TK_PIPE;
-        } break;
-
-        case '?': {
-            if (ly_lexer_is_laye(lexer) && ly_lexer_try_advance(lexer, '?')) {
-                if (ly_lexer_try_advance(lexer, '=')) {
-                    token.kind = LY_TK_QUESTION_QUESTION_EQUAL;
-                } else token.kind = LY_TK_QUESTION_QUESTION;
-            } else token.kind = LY_TK_QUESTION;
-        } break;
-
-        case '_': case '$':
-        case 'a': case 'b': case 'c': case 'd': case 'e':
-        case 'f': case 'g': case 'h': case 'i': case 'j':
-        case 'k': case 'l': case 'm': case 'n': case 'o':
-        case 'p': case 'q': case 'r': case 's': case 't':
-        case 'u': case 'v': case 'w': case 'x': case 'y':
-        case 'z':
-        case 'A': case 'B': case 'C': case 'D': case 'E':
-        case 'F': case 'G': case 'H': case 'I': case 'J':
-        case 'K': case 'L': case 'M': case 'N': case 'O':
-        case 'P': case 'Q': case 'R': case 'S': case 'T':
-        case 'U': case 'V': case 'W': case 'X': case 'Y':
-        case 'Z': {
-            k_string ident_builder = {};
-            k_da_push_many(&ident_builder, lexer->source->text.data + begin_position, c_stride);
-
-            while (
-                (lexer->current_codepoint >= 'a' && lexer->current_codepoint <= 'z') ||
-                (lexer->current_codepoint >= 'A' && lexer->current_codepoint <= 'Z') ||
-                (lexer->current_codepoint >= '0' && lexer->current_codepoint <= '9') ||
-                lexer->current_codepoint == '_' || lexer->current_codepoint == '$'
-            ) {
-                k_da_push_many(&ident_builder, lexer->source->text.data + lexer->current_position, lexer->current_stride);
-                ly_lexer_next_character(lexer);
-            }
+    const char* text = lexer->normalized.text.data;
+    isize_t count = lexer->normalized.text.count;
+    isize_t position = begin_position;
+
+    unsigned char first = position < count ? k_cast(unsigned char) text[position] : 0;
+
+    // Every token is dispatched on the class of its first byte with a single indirect jump where the compiler allows it.
+#if defined(K_COMPUTED_GOTO)
+#    pragma GCC diagnostic push
+#    pragma GCC diagnostic ignored "-Wpedantic"
+#    if defined(K_CLANG)
+#        pragma clang diagnostic ignored "-Wgnu-label-as-value"
+#    endif // K_CLANG
+    static const void* const byte_class_handlers[LY_BYTE_CLASS_COUNT] = {
+        [LY_BYTE_OTHER] = &&lex_other,
+        [LY_BYTE_END] = &&lex_end,
+        [LY_BYTE_NEWLINE] = &&lex_newline,
+        [LY_BYTE_IDENTIFIER] = &&lex_identifier,
+        [LY_BYTE_DIGIT] = &&lex_digit,
+        [LY_BYTE_DOT] = &&lex_dot,
+        [LY_BYTE_PUNCTUATOR] = &&lex_punctuator,
+        [LY_BYTE_LAYE_DIGIT] = &&lex_laye_digit,
+    };
 
-            char* ident_text = k_arena_alloc(lexer->context->string_arena, ident_builder.count + 1);
-            assert(ident_text[ident_builder.count] == 0);
-            memcpy(ident_text, ident_builder.data, k_cast(size_t)ident_builder.count);
-
-            token.text_value = k_sv(ident_text, ident_builder.count);
-            k_da_free(&ident_builder);
-
-            token.kind = LY_TK_PP_NOT_KEYWORD;
-        } break;
-
-        lex_pp_number:
-        case '0': case '1': case '2': case '3': case '4':
-        case '5': case '6': case '7': case '8': case '9': {
-            if (ly_lexer_is_c(lexer)) {
-                // lex pp numbers
-                while (!ly_lexer_is_at_end(lexer)) {
-                    if (lexer->current_codepoint == '.')
-                        ly_lexer_next_character(lexer);
-                    else if (lexer->current_codepoint == '\'' && ly_lexer_peek(lexer, 1) >= '0' && ly_lexer_peek(lexer, 1) <= '9') {
-                        ly_lexer_next_character(lexer); // omnom single quote
-                        ly_lexer_next_character(lexer); // omnom digit
-                    } else if (
-                        (lexer->current_codepoint == 'e' || lexer->current_codepoint == 'E' || lexer->current_codepoint == 'p' || lexer->current_codepoint == 'P') &&
-                        (ly_lexer_peek(lexer, 1) == '+' || ly_lexer_peek(lexer, 1) == '-')
-                    ) {
-                        ly_lexer_next_character(lexer); // omnom exponent character
-                        ly_lexer_next_character(lexer); // omnom sign
-                    } else if ( // TODO(local): Syntax facts functions for identifiers n stuff.
-                        (lexer->current_codepoint >= 'a' && lexer->current_codepoint <= 'z') ||
-                        (lexer->current_codepoint >= 'A' && lexer->current_codepoint <= 'Z') ||
-                        (lexer->current_codepoint >= '0' && lexer->current_codepoint <= '9') ||
-                        lexer->current_codepoint == '_' || lexer->current_codepoint == '$'
-                    ) {
-                        ly_lexer_next_character(lexer); // omnom identifier continue
-                    } else break;
-                }
-
-                token.kind = LY_TK_PP_NUMBER;
-            } else {
-                // lex laye numbers
-
-                // TODO(local): Actually scan and lex all the fun Laye number tokens.
-                while (lexer->current_codepoint >= '0' && lexer->current_codepoint <= '9') {
-                    ly_lexer_next_character(lexer);
-                }
-
-                token.kind = LY_TK_INTEGER_CONSTANT;
-            }
-        } break;
+    goto *byte_class_handlers[lexer->byte_classes[first]];
+#    pragma GCC diagnostic pop
+#else
+    switch (lexer->byte_classes[first]) {
+        default: goto lex_other;
+        case LY_BYTE_END: goto lex_end;
+        case LY_BYTE_NEWLINE: goto lex_newline;
+        case LY_BYTE_IDENTIFIER: goto lex_identifier;
+        case LY_BYTE_DIGIT: goto lex_digit;
+        case LY_BYTE_DOT: goto lex_dot;
+        case LY_BYTE_PUNCTUATOR: goto lex_punctuator;
+        case LY_BYTE_LAYE_DIGIT: goto lex_laye_digit;
     }
+#endif // K_COMPUTED_GOTO
+
+lex_other: {
+    if (first >= 0x80) {
+        int32_t codepoint = 0;
+        isize_t stride = 1;
+        bool is_ill_formed = K_UNICODE_SUCCESS != k_utf8_decode(text, count, position, &codepoint, &stride);
+        if (!is_ill_formed && ly_is_identifier_start(codepoint)) {
+            position += stride;
+            goto lex_identifier_continue;
+        }
+
+        // Ill-formed UTF-8 was already reported when the source was normalized, and is skipped a byte at a time like everywhere else.
+        if (is_ill_formed) {
+            stride = 1;
+        } else if (lexer->reports_diagnostics) {
+            ly_err_invalid_character(lexer->context, ly_lexer_location(lexer, position));
+        }
 
-    isize_t end_position = lexer->current_position;
-    ch_asserts(lexer->context->diag, end_position > begin_position, lexer->source, begin_position, "Lexer did not consume a character.");
+        position += stride;
+        goto token_done;
+    }
+
+    if (ly_punctuator_candidates_by_byte[first].count != 0) {
+        goto lex_punctuator;
+    }
+
+    if (lexer->reports_diagnostics)
+        ly_err_invalid_character(lexer->context, ly_lexer_location(lexer, position));
+
+    position++;
+    goto token_done;
+}
+
+lex_end: {
+    token.kind = LY_TK_END_OF_FILE;
+    goto token_done;
+}
+
+lex_newline: {
+    ch_asserts(lexer->context->diag, !lexer->newlines_are_trivia, lexer->source, ly_lexer_location(lexer, begin_position), "The newline character is white space unless within a preprocessing directive.");
+    token.kind = LY_TK_PP_END_OF_DIRECTIVE;
+    position++;
+    goto token_done;
+}
+
+lex_identifier: {
+    position++;
+lex_identifier_continue:
+    position = ly_lexer_scan_identifier(lexer, position);
+
+    // Only the first occurrence of a spelling is copied, into the intern table; every token of it shares that copy.
+    k_intern_table* intern_table = &lexer->context->intern_table;
+    token.text_id = k_intern(intern_table, ly_lexer_spelling(lexer, begin_position, position));
+    token.text_value = k_intern_get(intern_table, token.text_id);
+
+    token.kind = ly_keyword_table_lookup(lexer->keyword_table, token.text_value);
+    goto token_done;
+}
+
+lex_dot: {
+    if (position + 1 < count && text[position + 1] >= '0' && text[position + 1] <= '9') {
+        goto lex_digit;
+    }
+
+    goto lex_punctuator;
+}
+
+lex_digit: {
+    // lex pp numbers
+    position = ly_lexer_scan_pp_number(lexer, position + 1);
+    token.kind = LY_TK_PP_NUMBER;
+    token.text_value = ly_lexer_spelling(lexer, begin_position, position);
+    goto token_done;
+}
 
+lex_laye_digit: {
+    position++;
+
+    // TODO(local): Actually scan and lex all the fun Laye number tokens.
+    while (position < count && text[position] >= '0' && text[position] <= '9') {
+        position++;
+    }
+
+    token.kind = LY_TK_INTEGER_CONSTANT;
+    goto token_done;
+}
+
+lex_punctuator: {
+    isize_t length = 0;
+    token.kind = ly_lexer_match_punctuator(lexer, position, &length);
+    if (length == 0) {
+        // Only a byte starting nothing but punctuators of another language gets here.
+        if (lexer->reports_diagnostics)
+            ly_err_invalid_character(lexer->context, ly_lexer_location(lexer, position));
+        length = 1;
+    }
+
+    position += length;
+    goto token_done;
+}
+
+token_done:;
+    isize_t end_position = position;
+    ch_asserts(lexer->context->diag, end_position > begin_position || token.kind == LY_TK_END_OF_FILE, lexer->source, ly_lexer_location(lexer, begin_position), "Lexer did not consume a character.");
+
+    // The end is mapped from the last character of the token so that a line splice right after it is not counted as part of it.
     ch_range range = {
-        .source = lexer->source,
-        .begin = begin_position,
-        .end = end_position,
+        .begin = ly_lexer_location(lexer, begin_position),
+        .end = end_position == begin_position ? ly_lexer_location(lexer, begin_position) : ly_lexer_location(lexer, end_position - 1) + 1,
     };
 
-    // TODO(local): Store the trivia in a trivia list for later.
-    ly_lexer_read_relevant_trivia(lexer, false);
+    // A directive ends with its newline, so the token after one starts a line; anything else leaves the lexer mid-line until trivia says otherwise.
+    lexer->is_at_start_of_line = token.kind == LY_TK_PP_END_OF_DIRECTIVE;
 
     token.range = range;
+    *out_token = token;
+
+    // TODO(local): Store the trivia in a trivia list for later.
+    return ly_lexer_read_relevant_trivia(lexer, end_position, false);
+}
+
+CHOIR_API ly_token ly_lexer_read_pp_token(ly_lexer* lexer) {
+    assert(lexer != nullptr);
+
+    ly_token token;
+    ly_lexer_seek(lexer, ly_lexer_lex_token(lexer, lexer->current_position, &token));
     return token;
 }
 
+CHOIR_API isize_t ly_lexer_lex_until(ly_lexer* lexer, isize_t position, isize_t end_position, ly_tokens* tokens) {
+    assert(lexer != nullptr);
+    assert(tokens != nullptr);
+
+    // The position is only ever handed from one token to the next, never staged in the lexer, so there is no decoding between tokens.
+    isize_t count = lexer->normalized.text.count;
+    ly_token token;
+    while (position < end_position && position < count) {
+        position = ly_lexer_lex_token(lexer, position, &token);
+        ly_tokens_push(tokens, &token);
+
+        // A NUL in the text ends it early, and lexing it again would only give the same token forever.
+        if (token.kind == LY_TK_END_OF_FILE) {
+            return position;
+        }
+    }
+
+    if (position >= count) {
+        ly_lexer_lex_token(lexer, position, &token);
+        ly_tokens_push(tokens, &token);
+    }
+
+    return position;
+}
+
+CHOIR_API void ly_lexer_lex_all(ch_source* source, ly_lexer_mode mode, ly_tokens* tokens) {
+    assert(source != nullptr);
+    assert(tokens != nullptr);
+
+    ly_lexer lexer;
+    ly_lexer_init(&lexer, tokens->context, source, mode);
+
+    // Sizing the buffer once from the source size saves every grow-and-copy on the way for all but the densest code.
+    ly_tokens_reserve(tokens, tokens->count + lexer.normalized.text.count / LY_LEXER_BYTES_PER_TOKEN_ESTIMATE + 1);
+    ly_lexer_lex_until(&lexer, 0, lexer.normalized.text.count, tokens);
+}
+
+CHOIR_API void ly_lexer_set_keyword_table(ly_lexer* lexer, const ly_keyword_table* table) {
+    assert(lexer != nullptr);
+    assert(table != nullptr);
+
+    if (0 != (lexer->mode & LY_LEXMODE_LAYE)) {
+        lexer->laye_keyword_table = table;
+    } else {
+        lexer->c_keyword_table = table;
+    }
+
+    lexer->keyword_table = table;
+}
+
 CHOIR_API void ly_lexer_push_mode(ly_lexer* lexer, ly_lexer_mode mode) {
+    assert(lexer != nullptr);
+    assert(lexer->mode_stack_depth < LY_LEXER_MODE_STACK_DEPTH && "Lexer modes are nested too deeply");
+
+    lexer->mode_stack = (lexer->mode_stack << LY_LEXER_MODE_BITS) | k_cast(uint64_t) lexer->mode;
+    lexer->mode_stack_depth++;
+    ly_lexer_set_mode(lexer, mode);
 }
 
 CHOIR_API void ly_lexer_pop_mode(ly_lexer* lexer) {
+    assert(lexer != nullptr);
+    assert(lexer->mode_stack_depth > 0 && "Popped a lexer mode which was never pushed");
+
+    ly_lexer_mode mode = k_cast(ly_lexer_mode)(lexer->mode_stack & ((1 << LY_LEXER_MODE_BITS) - 1));
+    lexer->mode_stack >>= LY_LEXER_MODE_BITS;
+    lexer->mode_stack_depth--;
+    ly_lexer_set_mode(lexer, mode);
 }
@@ -0,0 +1,465 @@
+#include <laye/core.h>
+
+/// The smallest piece ly_lexer_lex_all_parallel splits a source into; anything smaller is not worth a worker waking up for.
+#define LY_LEX_CHUNK_SIZE_MIN (1 << 20)
+/// How many chunks ly_lexer_lex_all_parallel aims for per worker, so that a worker with a slow chunk leaves the rest to be stolen.
+#define LY_LEX_CHUNKS_PER_WORKER 4
+
+/// Everything one worker of a parallel lex owns: a context of its own, so that lexing never touches anything another worker can see.
+/// Its arenas and intern table are private; only the sources' locations and the built-in keyword tables are shared, read-only.
+typedef struct ly_lex_worker {
+    k_arena string_arena;
+    k_arena node_arena;
+    k_arena diag_arena;
+    k_diag diag;
+    ch_context context;
+
+    /// Where the diagnostics of what is being lexed are collected.
+    k_diag_data_group* diagnostics;
+    /// The main context's handle for each of this worker's intern handles, filled in as tokens are merged.
+    k_intern_id* text_id_map;
+} ly_lex_worker;
+
+/// The shared state of one ly_lexer_lex_sources call.
+typedef struct ly_lex_sources_state {
+    ch_source** sources;
+    ly_lexer_mode mode;
+    ly_lex_worker* workers;
+
+    /// The tokens and diagnostics of each source, indexed by source rather than by worker, so they can be merged in source order.
+    ly_tokens* tokens;
+    k_diag_data_group* diagnostics;
+} ly_lex_sources_state;
+
+/// One piece of a source split by ly_lexer_lex_all_parallel, lexed on a guess at the state the lexer is in where it begins.
+typedef struct ly_lex_chunk {
+    /// The newline the chunk begins on, or 0 for the first, and the one the next chunk begins on.
+    isize_t begin;
+    isize_t end;
+
+    /// The worker which lexed the chunk, whose context its lexer and tokens belong to.
+    isize_t worker_index;
+    ly_lexer lexer;
+    ly_tokens tokens;
+    k_diag_data_group diagnostics;
+    /// Where the lexer stopped, which is where the leading trivia of the token after its last begins.
+    isize_t position;
+
+    /// The first of the chunk's tokens and diagnostics which are part of the result; those before were lexed in the wrong state.
+    isize_t first_token;
+    isize_t first_diagnostic;
+} ly_lex_chunk;
+
+/// The shared state of one ly_lexer_lex_all_parallel call.
+typedef struct ly_lex_chunks_state {
+    const ly_normalized_source* normalized;
+    ly_lexer_mode mode;
+    ly_lex_worker* workers;
+    ly_lex_chunk* chunks;
+} ly_lex_chunks_state;
+
+/// A k_diag callback which keeps a worker's diagnostics to be reported later, in source order, instead of reporting them as they happen.
+static void ly_lex_worker_collect_diagnostics(void* userdata, k_diag_data_group group) {
+    ly_lex_worker* worker = userdata;
+    k_da_push_many(worker->diagnostics, group.data, group.count);
+}
+
+static ly_lex_worker* ly_lex_workers_create(ch_context* context, isize_t worker_count) {
+    ly_lex_worker* workers = calloc(k_cast(size_t) worker_count, sizeof(ly_lex_worker));
+    assert(workers != nullptr && "Buy more RAM lol");
+
+    for (isize_t i = 0; i < worker_count; i++) {
+        ly_lex_worker* worker = &workers[i];
+        k_arena_init(&worker->string_arena);
+        k_arena_init(&worker->node_arena);
+        k_arena_init(&worker->diag_arena);
+        k_diag_init(&worker->diag, &worker->diag_arena, ly_lex_worker_collect_diagnostics, worker);
+        ch_context_init(&worker->context, &worker->diag, &worker->string_arena, &worker->node_arena);
+
+        // Workers only ever decode locations of sources already added, so sharing the source manager read-only is safe.
+        worker->context.source_manager = context->source_manager;
+        worker->context.tab_width = context->tab_width;
+        // The keyword table is only read once built, so the workers share the one in the main context rather than building their own.
+        worker->context.c_dialect_keys = context->c_dialect_keys;
+        worker->context.c_keyword_table = context->c_keyword_table;
+    }
+
+    return workers;
+}
+
+static void ly_lex_workers_destroy(ly_lex_worker* workers, isize_t worker_count) {
+    for (isize_t i = 0; i < worker_count; i++) {
+        free(workers[i].text_id_map);
+        // The worker's diagnostics were already flushed after everything it lexed, so this reports nothing.
+        k_diag_deinit(&workers[i].diag);
+        k_arena_deinit(&workers[i].diag_arena);
+        k_arena_deinit(&workers[i].node_arena);
+        k_arena_deinit(&workers[i].string_arena);
+    }
+
+    free(workers);
+}
+
+/// Returns the map from the worker's intern handles to the main context's for ly_tokens_append, which is only sized once the worker is done lexing.
+static k_intern_id* ly_lex_worker_text_id_map(ly_lex_worker* worker) {
+    if (worker->text_id_map == nullptr) {
+        worker->text_id_map = calloc(k_cast(size_t) worker->context.intern_table.entries.count, sizeof(k_intern_id));
+        assert(worker->text_id_map != nullptr && "Buy more RAM lol");
+    }
+
+    return worker->text_id_map;
+}
+
+/// Report diagnostics a worker collected to the main context's diagnostics.
+static void ly_lex_report_diagnostics(ch_context* context, const k_diag_data* data, isize_t count) {
+    for (isize_t i = 0; i < count; i++) {
+        k_diag_data diag_data = data[i];
+
+        // The message lives in the worker's diagnostic arena, which is about to go away.
+        if (diag_data.message.count != 0) {
+            char* message = k_arena_alloc_uninit(context->diag->string_arena, k_cast(size_t) diag_data.message.count);
+            memcpy(message, diag_data.message.data, k_cast(size_t) diag_data.message.count);
+            diag_data.message = k_sv(message, diag_data.message.count);
+        }
+
+        k_diag_emit(context->diag, diag_data);
+    }
+}
+
+static void ly_lex_source_task(void* userdata, isize_t task_index, isize_t worker_index) {
+    ly_lex_sources_state* state = userdata;
+    ly_lex_worker* worker = &state->workers[worker_index];
+
+    worker->diagnostics = &state->diagnostics[task_index];
+    worker->diagnostics->arena = &worker->diag_arena;
+
+    ly_tokens_init(&state->tokens[task_index], &worker->context);
+    ly_lexer_lex_all(state->sources[task_index], state->mode, &state->tokens[task_index]);
+
+    // Everything about this source has to be collected before the worker moves on to the next.
+    k_diag_flush(&worker->diag);
+}
+
+CHOIR_API void ly_lexer_lex_sources(ch_context* context, k_thread_pool* pool, ch_source** sources, isize_t source_count, ly_lexer_mode mode, ly_tokens* out_tokens) {
+    assert(context != nullptr);
+    assert(pool != nullptr);
+    assert(source_count >= 0);
+
+    if (source_count == 0) {
+        return;
+    }
+
+    // Locations come from the one context, so sources get them up front and in order, exactly as lexing them one after another would give them.
+    // Workers only ever read the sources, so every line table is built here, in the context's own arena, rather than by whichever worker needs it first.
+    for (isize_t i = 0; i < source_count; i++) {
+        if (sources[i]->location == CH_LOCATION_NONE) {
+            ch_context_add_source(context, sources[i]);
+        }
+
+        isize_t line = 0;
+        isize_t column = 0;
+        ch_source_get_line_column(context, sources[i], 0, &line, &column);
+    }
+
+    isize_t worker_count = k_thread_pool_get_worker_count(pool);
+    ly_lex_worker* workers = ly_lex_workers_create(context, worker_count);
+    ly_tokens* worker_tokens = calloc(k_cast(size_t) source_count, sizeof(ly_tokens));
+    k_diag_data_group* diagnostics = calloc(k_cast(size_t) source_count, sizeof(k_diag_data_group));
+    assert(worker_tokens != nullptr && diagnostics != nullptr && "Buy more RAM lol");
+
+    // Every encoding is checked up front for the same reason. Its errors are collected first among the source's diagnostics, which is where lexing it on its own reports them.
+    for (isize_t i = 0; i < source_count; i++) {
+        workers[0].diagnostics = &diagnostics[i];
+        workers[0].diagnostics->arena = &workers[0].diag_arena;
+        ly_source_check_encoding(&workers[0].context, sources[i]);
+        k_diag_flush(&workers[0].diag);
+    }
+
+    ly_lex_sources_state state = {
+        .sources = sources,
+        .mode = mode,
+        .workers = workers,
+        .tokens = worker_tokens,
+        .diagnostics = diagnostics,
+    };
+
+    k_thread_pool_run(pool, source_count, ly_lex_source_task, &state);
+
+    // Merging in source order makes the result independent of which worker lexed what: identifiers are interned again in order of first use,
+    // which hands out the same handles lexing the sources one after another would, and diagnostics are reported in source order.
+    for (isize_t i = 0; i < source_count; i++) {
+        isize_t worker_index = 0;
+        while (worker_tokens[i].context != &workers[worker_index].context) {
+            worker_index++;
+        }
+
+        ly_tokens_init(&out_tokens[i], context);
+        ly_tokens_append(&out_tokens[i], &worker_tokens[i], ly_lex_worker_text_id_map(&workers[worker_index]));
+        ly_lex_report_diagnostics(context, diagnostics[i].data, diagnostics[i].count);
+        ly_tokens_deinit(&worker_tokens[i]);
+    }
+
+    ly_lex_workers_destroy(workers, worker_count);
+    free(diagnostics);
+    free(worker_tokens);
+}
+
+/// Returns true if a chunk may begin on the newline at 'position', as far as the lines around it tell.
+/// String and character literals cannot span lines, so comments and directives are all a newline can be inside of; guessing wrong only costs lexing the seam again.
+static bool ly_lex_is_chunk_boundary(k_string_view text, isize_t position) {
+    isize_t line_begin = position;
+    while (line_begin > 0 && text.data[line_begin - 1] != '\n') {
+        line_begin--;
+    }
+
+    // The newline ending a directive is part of it.
+    isize_t first = line_begin;
+    while (first < position && (text.data[first] == ' ' || text.data[first] == '\t')) {
+        first++;
+    }
+
+    if (first < position && text.data[first] == '#') {
+        return false;
+    }
+
+    // A block comment opened on this line may well go on past it.
+    for (isize_t i = first; i + 1 < position; i++) {
+        if (text.data[i] == '/' && text.data[i + 1] == '*') {
+            return false;
+        }
+    }
+
+    // A line starting with '*' is most likely the middle of a block comment.
+    isize_t next = position + 1;
+    while (next < text.count && (text.data[next] == ' ' || text.data[next] == '\t')) {
+        next++;
+    }
+
+    return next >= text.count || text.data[next] != '*';
+}
+
+static void ly_lex_chunk_task(void* userdata, isize_t task_index, isize_t worker_index) {
+    ly_lex_chunks_state* state = userdata;
+    ly_lex_worker* worker = &state->workers[worker_index];
+    ly_lex_chunk* chunk = &state->chunks[task_index];
+
+    chunk->worker_index = worker_index;
+    worker->diagnostics = &chunk->diagnostics;
+    worker->diagnostics->arena = &worker->diag_arena;
+
+    ly_lexer_init_normalized(&chunk->lexer, &worker->context, state->normalized, state->mode);
+    // The guess is that the newline a chunk begins on ends a line with a token on it, after which the lexer has not seen a newline yet.
+    chunk->lexer.is_at_start_of_line = chunk->begin == 0;
+
+    ly_tokens_init(&chunk->tokens, &worker->context);
+    ly_tokens_reserve(&chunk->tokens, (chunk->end - chunk->begin) / LY_LEXER_BYTES_PER_TOKEN_ESTIMATE + 1);
+    chunk->position = ly_lexer_lex_until(&chunk->lexer, chunk->begin, chunk->end, &chunk->tokens);
+
+    k_diag_flush(&worker->diag);
+}
+
+static bool ly_lex_chunk_has_ended(const ly_lex_chunk* chunk) {
+    return chunk->tokens.count != 0 && LY_TK_END_OF_FILE == ly_tokens_kind(&chunk->tokens, chunk->tokens.count - 1);
+}
+
+/// Returns the index of the first token of 'next' which was lexed in the state 'chunk' is actually in, or -1 if 'next' was never in it.
+/// Between tokens, the lexer state is only the position and whether the next token starts a line, and both follow from the kind and range of the token before.
+static isize_t ly_lex_chunk_find_seam(const ly_lex_chunk* chunk, const ly_lex_chunk* next) {
+    if (chunk->position == next->begin && !chunk->lexer.is_at_start_of_line) {
+        return 0;
+    }
+
+    assert(chunk->tokens.count != 0);
+    isize_t last = chunk->tokens.count - 1;
+    ch_location begin = chunk->tokens.begins[last];
+
+    // Tokens never overlap, so the one to compare against is found by where it begins.
+    isize_t low = 0;
+    isize_t high = next->tokens.count;
+    while (low < high) {
+        isize_t middle = low + (high - low) / 2;
+        if (next->tokens.begins[middle] < begin) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    if (low < next->tokens.count && next->tokens.begins[low] == begin && next->tokens.ends[low] == chunk->tokens.ends[last] && next->tokens.kinds[low] == chunk->tokens.kinds[last]) {
+        return low + 1;
+    }
+
+    return -1;
+}
+
+/// Returns the index of the first diagnostic of 'chunk' at or after 'position'; those before it were reported in the wrong state.
+/// Diagnostics only carry a line and column, which order the same way positions do within the one source.
+static isize_t ly_lex_chunk_find_first_diagnostic(ch_context* context, const ly_lex_chunk* chunk, isize_t position) {
+    if (chunk->diagnostics.count == 0) {
+        return 0;
+    }
+
+    const ly_normalized_source* normalized = &chunk->lexer.normalized;
+    isize_t offset = normalized->offsets.count == 0 ? position : ly_source_original_offset(normalized, position);
+
+    isize_t line = 0;
+    isize_t column = 0;
+    ch_source_get_line_column(context, normalized->source, offset, &line, &column);
+
+    for (isize_t i = 0; i < chunk->diagnostics.count; i++) {
+        k_diag_source diag_source = chunk->diagnostics.data[i].source;
+        if (diag_source.line > line || (diag_source.line == line && diag_source.column >= column)) {
+            return i;
+        }
+    }
+
+    return chunk->diagnostics.count;
+}
+
+/// Returns a view of the tokens from 'first' on, sharing the buffer's arrays and payloads.
+static ly_tokens ly_tokens_slice(const ly_tokens* tokens, isize_t first) {
+    ly_tokens slice = *tokens;
+    slice.kinds += first;
+    slice.flags += first;
+    slice.begins += first;
+    slice.ends += first;
+    slice.data += first;
+    slice.count -= first;
+    slice.capacity -= first;
+    return slice;
+}
+
+CHOIR_API void ly_lexer_lex_all_parallel(k_thread_pool* pool, ch_source* source, ly_lexer_mode mode, ly_tokens* tokens) {
+    assert(pool != nullptr);
+    assert(source != nullptr);
+    assert(tokens != nullptr);
+
+    // Newlines are tokens in a directive, so no newline is ever between two of them.
+    isize_t worker_count = k_thread_pool_get_worker_count(pool);
+    if (worker_count < 2 || source->text.count < 2 * LY_LEX_CHUNK_SIZE_MIN || 0 != (mode & (LY_LEXMODE_DIRECTIVE | LY_LEXMODE_HEADER_NAMES))) {
+        ly_lexer_lex_all(source, mode, tokens);
+        return;
+    }
+
+    ch_context* context = tokens->context;
+
+    // Normalizing reports any ill-formed UTF-8 before lexing starts, just as ly_lexer_init does.
+    ly_normalized_source normalized;
+    ly_source_normalize(&normalized, context, source, 0 != (mode & LY_LEXMODE_C));
+    k_string_view text = normalized.text;
+
+    // Workers decode the locations of their diagnostics, so the line table is built here rather than by all of them at once.
+    isize_t line = 0;
+    isize_t column = 0;
+    ch_source_get_line_column(context, source, 0, &line, &column);
+
+    isize_t chunk_count_max = text.count / LY_LEX_CHUNK_SIZE_MIN;
+    if (chunk_count_max > worker_count * LY_LEX_CHUNKS_PER_WORKER) chunk_count_max = worker_count * LY_LEX_CHUNKS_PER_WORKER;
+    if (chunk_count_max < 1) chunk_count_max = 1;
+
+    ly_lex_chunk* chunks = calloc(k_cast(size_t) chunk_count_max, sizeof(ly_lex_chunk));
+    assert(chunks != nullptr && "Buy more RAM lol");
+
+    isize_t chunk_count = 1;
+    for (isize_t i = 1; i < chunk_count_max; i++) {
+        isize_t position = i * (text.count / chunk_count_max);
+        if (position <= chunks[chunk_count - 1].begin) position = chunks[chunk_count - 1].begin + 1;
+        while (position < text.count) {
+            const char* newline = memchr(text.data + position, '\n', k_cast(size_t)(text.count - position));
+            if (newline == nullptr) {
+                position = text.count;
+                break;
+            }
+
+            position = k_cast(isize_t)(newline - text.data);
+            if (ly_lex_is_chunk_boundary(text, position)) {
+                break;
+            }
+
+            position++;
+        }
+
+        if (position >= text.count) {
+            break;
+        }
+
+        chunks[chunk_count - 1].end = position;
+        chunks[chunk_count++].begin = position;
+    }
+
+    chunks[chunk_count - 1].end = text.count;
+
+    if (chunk_count < 2) {
+        free(chunks);
+
+        ly_lexer lexer;
+        ly_lexer_init_normalized(&lexer, context, &normalized, mode);
+        ly_tokens_reserve(tokens, tokens->count + text.count / LY_LEXER_BYTES_PER_TOKEN_ESTIMATE + 1);
+        ly_lexer_lex_until(&lexer, 0, text.count, tokens);
+        return;
+    }
+
+    ly_lex_worker* workers = ly_lex_workers_create(context, worker_count);
+    ly_lex_chunks_state state = {
+        .normalized = &normalized,
+        .mode = mode,
+        .workers = workers,
+        .chunks = chunks,
+    };
+
+    k_thread_pool_run(pool, chunk_count, ly_lex_chunk_task, &state);
+
+    // Walk the seams in order, always from the last chunk known to be right. Its state where the next one begins is only certain now;
+    // where the next chunk's guess was wrong, the known chunk carries on a token at a time until the two agree, or until it has lexed all of the other itself.
+    for (isize_t i = 1; i < chunk_count; i++) {
+        chunks[i].first_token = chunks[i].tokens.count;
+        chunks[i].first_diagnostic = chunks[i].diagnostics.count;
+    }
+
+    isize_t known_index = 0;
+    for (isize_t i = 1; i < chunk_count && !ly_lex_chunk_has_ended(&chunks[known_index]); i++) {
+        ly_lex_chunk* known = &chunks[known_index];
+        ly_lex_chunk* next = &chunks[i];
+
+        isize_t seam = ly_lex_chunk_find_seam(known, next);
+        if (seam < 0) {
+            ly_lex_worker* worker = &workers[known->worker_index];
+            worker->diagnostics = &known->diagnostics;
+
+            while (seam < 0 && known->position < next->end && !ly_lex_chunk_has_ended(known)) {
+                known->position = ly_lexer_lex_until(&known->lexer, known->position, known->position + 1, &known->tokens);
+                seam = ly_lex_chunk_find_seam(known, next);
+            }
+
+            k_diag_flush(&worker->diag);
+        }
+
+        if (seam >= 0) {
+            next->first_token = seam;
+            next->first_diagnostic = ly_lex_chunk_find_first_diagnostic(context, next, known->position);
+            known_index = i;
+        }
+    }
+
+    isize_t token_count = 0;
+    for (isize_t i = 0; i < chunk_count; i++) {
+        token_count += chunks[i].tokens.count - chunks[i].first_token;
+    }
+
+    ly_tokens_reserve(tokens, tokens->count + token_count);
+
+    // As with ly_lexer_lex_sources, merging in order interns identifiers in order of first use, exactly as lexing sequentially does.
+    for (isize_t i = 0; i < chunk_count; i++) {
+        ly_lex_chunk* chunk = &chunks[i];
+        if (chunk->first_token < chunk->tokens.count) {
+            ly_tokens slice = ly_tokens_slice(&chunk->tokens, chunk->first_token);
+            ly_tokens_append(tokens, &slice, ly_lex_worker_text_id_map(&workers[chunk->worker_index]));
+        }
+
+        ly_lex_report_diagnostics(context, chunk->diagnostics.data + chunk->first_diagnostic, chunk->diagnostics.count - chunk->first_diagnostic);
+        ly_tokens_deinit(&chunk->tokens);
+    }
+
+    ly_lex_workers_destroy(workers, worker_count);
+    free(chunks);
+}
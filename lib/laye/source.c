@@ -0,0 +1,160 @@
+#include <laye/core.h>
+#include <laye/diag.h>
+
+/// Returns true if 'text' contains anything translation phases 1 and 2 would change.
+static bool ly_source_needs_normalization(k_string_view text, bool splice_lines) {
+    if (nullptr != memchr(text.data, '\r', k_cast(size_t) text.count)) {
+        return true;
+    }
+
+    // Without carriage returns every newline is already a lone '\n', so only splices are left to look for.
+    if (!splice_lines) {
+        return false;
+    }
+
+    const char* cursor = text.data;
+    const char* end = text.data + text.count;
+    while (cursor < end) {
+        const char* backslash = memchr(cursor, '\\', k_cast(size_t)(end - cursor));
+        if (backslash == nullptr) {
+            return false;
+        }
+
+        if (backslash + 1 < end && backslash[1] == '\n') {
+            return true;
+        }
+
+        cursor = backslash + 1;
+    }
+
+    return false;
+}
+
+/// Returns the length of the newline sequence at 'offset' in 'text', or 0 if there is none.
+/// The sequences '\n', '\r', '\r\n' and '\n\r' each count as a single newline.
+static isize_t ly_source_newline_length(k_string_view text, isize_t offset) {
+    if (offset >= text.count || (text.data[offset] != '\n' && text.data[offset] != '\r')) {
+        return 0;
+    }
+
+    if (offset + 1 < text.count && (text.data[offset + 1] == '\n' || text.data[offset + 1] == '\r') && text.data[offset + 1] != text.data[offset]) {
+        return 2;
+    }
+
+    return 1;
+}
+
+CHOIR_API void ly_source_check_encoding(ch_context* context, ch_source* source) {
+    assert(context != nullptr);
+    assert(source != nullptr);
+    assert(source->location != CH_LOCATION_NONE);
+
+    if (source->is_encoding_checked) {
+        return;
+    }
+
+    source->is_encoding_checked = true;
+
+    const char* text = source->text.data;
+    isize_t count = source->text.count;
+
+    // Each error is reported once, at its exact offset.
+    isize_t offset = k_ascii_prefix_length(text, count);
+    while (offset < count) {
+        k_unicode_decode_result reason;
+        isize_t invalid_length;
+        offset = k_utf8_validate(text, count, offset, &reason, &invalid_length);
+        if (offset == count) {
+            break;
+        }
+
+        ly_err_invalid_utf8(context, ch_source_get_location(source, offset), reason);
+        offset += invalid_length;
+
+        // Continuation bytes left over from the same broken sequence, such as the tail of an encoded surrogate, are part of the one error already reported.
+        while (offset < count && (text[offset] & 0xC0) == 0x80) {
+            offset++;
+        }
+    }
+}
+
+CHOIR_API void ly_source_normalize(ly_normalized_source* normalized, ch_context* context, ch_source* source, bool splice_lines) {
+    assert(normalized != nullptr);
+    assert(context != nullptr);
+    assert(source != nullptr);
+
+    // A source gets its locations the first time it is loaded, which is when it is normalized for lexing.
+    if (source->location == CH_LOCATION_NONE) {
+        ch_context_add_source(context, source);
+    }
+
+    ly_source_check_encoding(context, source);
+
+    *normalized = (ly_normalized_source){
+        .source = source,
+        .text = source->text,
+    };
+
+    normalized->offsets.arena = context->string_arena;
+
+    if (!ly_source_needs_normalization(source->text, splice_lines)) {
+        return;
+    }
+
+    const char* text = source->text.data;
+    isize_t count = source->text.count;
+
+    char* buffer = k_arena_alloc_aligned(context->string_arena, k_cast(size_t) count + 1, 1);
+    isize_t buffer_count = 0;
+
+    isize_t position = 0;
+    while (position < count) {
+        char c = text[position];
+
+        if (c == '\n' || c == '\r') {
+            isize_t newline_length = ly_source_newline_length(source->text, position);
+            buffer[buffer_count++] = '\n';
+            position += newline_length;
+
+            // A lone '\r' becomes '\n' in place; only two-character sequences shift what follows.
+            if (newline_length == 2) {
+                k_da_push(&normalized->offsets, ((ly_source_offset){ .normalized_offset = buffer_count, .delta = position - buffer_count }));
+            }
+
+            continue;
+        }
+
+        if (splice_lines && c == '\\') {
+            isize_t newline_length = ly_source_newline_length(source->text, position + 1);
+            if (newline_length != 0) {
+                position += 1 + newline_length;
+                k_da_push(&normalized->offsets, ((ly_source_offset){ .normalized_offset = buffer_count, .delta = position - buffer_count }));
+                continue;
+            }
+        }
+
+        buffer[buffer_count++] = c;
+        position++;
+    }
+
+    buffer[buffer_count] = 0;
+    normalized->text = k_sv(buffer, buffer_count);
+}
+
+CHOIR_API isize_t ly_source_original_offset(const ly_normalized_source* normalized, isize_t offset) {
+    assert(normalized != nullptr);
+
+    // Find the last recorded point at or before 'offset'; everything from there on is shifted by its delta.
+    isize_t low = 0;
+    isize_t high = normalized->offsets.count;
+    while (low < high) {
+        isize_t middle = low + (high - low) / 2;
+        if (normalized->offsets.data[middle].normalized_offset <= offset) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    return low == 0 ? offset : offset + normalized->offsets.data[low - 1].delta;
+}
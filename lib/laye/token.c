@@ -1,5 +1,28 @@
 #include <laye/core.h>
 
+/// A keyword in the generated perfect hash table.
+/// The first and last eight bytes of the spelling, as zero padded little-endian words, reject every miss without a string compare, and fully match keywords of up to 16 bytes.
+typedef struct ly_keyword_slot {
+    uint64_t head;
+    uint64_t tail;
+    uint16_t kind;
+    uint16_t key;
+    uint8_t length;
+    const char* spelling;
+} ly_keyword_slot;
+
+static_assert(LY_TOKEN_KIND_COUNT <= UINT16_MAX, "Token kinds must fit in a keyword slot");
+static_assert(LY_TKKEY_ALL <= UINT16_MAX, "Keyword availability flags must fit in a keyword slot");
+
+// Generated by nob from <laye/tokens.h>; see src/gen_ly_keywords.c.
+#include "laye-keywords.inc"
+
+/// The kind of the keyword in each slot of the perfect hash table if it is available in the table's dialects, otherwise LY_TK_PP_NOT_KEYWORD.
+struct ly_keyword_table {
+    ly_token_key keys;
+    uint16_t kinds[LY_KEYWORD_HASH_SIZE];
+};
+
 CHOIR_API const char* ly_token_kind_get_name(ly_token_kind kind) {
     switch (kind) {
         default: return "[unknown Laye source token kind]";
@@ -14,7 +37,7 @@ CHOIR_API const char* ly_token_kind_get_spelling(ly_token_kind kind) {
         default: return NULL;
 #define LY_TOKEN(id) \
     case LY_TK_##id: return NULL;
-#define CH_PUNCT(id, spelling) \
+#define CH_PUNCT(id, spelling, flags) \
     case LY_TK_##id: return spelling;
 #define CH_KEYWORD(id, spelling, flags) \
     case LY_TK_KW_##id: return spelling;
@@ -36,3 +59,143 @@ CHOIR_API ly_token_key ly_token_kind_get_key(ly_token_kind kind) {
 #include <laye/tokens.h>
     }
 }
+
+static uint64_t ly_keyword_load_le32(const unsigned char* data) {
+    return k_cast(uint64_t) data[0] | k_cast(uint64_t) data[1] << 8 | k_cast(uint64_t) data[2] << 16 | k_cast(uint64_t) data[3] << 24;
+}
+
+/// Read up to the first eight bytes of 'data' as a little-endian word, zero padded, with a fixed number of loads whatever the count.
+static uint64_t ly_keyword_load_word(const unsigned char* data, isize_t count) {
+    if (count >= 8) {
+        return ly_keyword_load_le32(data) | ly_keyword_load_le32(data + 4) << 32;
+    }
+
+    // Two overlapping loads cover every byte; where they overlap, both contribute the same bits.
+    if (count >= 4) {
+        return ly_keyword_load_le32(data) | ly_keyword_load_le32(data + count - 4) << ((count - 4) * 8);
+    }
+
+    return k_cast(uint64_t) data[0] | k_cast(uint64_t) data[count / 2] << (count / 2 * 8) | k_cast(uint64_t) data[count - 1] << ((count - 1) * 8);
+}
+
+/// Returns the perfect hash slot of the keyword spelled by 'spelling', or -1 if it does not spell one in any dialect.
+static int32_t ly_keyword_find_slot(k_string_view spelling) {
+    if (spelling.count == 0 || spelling.count > LY_KEYWORD_MAX_LENGTH) {
+        return -1;
+    }
+
+    const unsigned char* data = k_cast(const unsigned char*) spelling.data;
+    uint64_t head = ly_keyword_load_word(data, spelling.count);
+    uint64_t tail = spelling.count <= 8 ? head : ly_keyword_load_word(data + spelling.count - 8, 8);
+
+    uint32_t slot_index = LY_KEYWORD_HASH(head, tail, spelling.count);
+    const ly_keyword_slot* slot = &ly_keyword_slots[slot_index];
+    if (slot->head != head || slot->tail != tail || slot->length != spelling.count) {
+        return -1;
+    }
+
+    // Only the middle of keywords longer than 16 bytes is not covered by the head and tail words.
+    if (spelling.count > 16 && 0 != memcmp(spelling.data + 8, slot->spelling + 8, k_cast(size_t)(spelling.count - 16))) {
+        return -1;
+    }
+
+    return k_cast(int32_t) slot_index;
+}
+
+CHOIR_API ly_token_kind ly_token_kind_from_keyword(k_string_view spelling, ly_token_key keys) {
+    // Normalized the same way as for a keyword table, so that C23 still has C's _Bool and the two always agree.
+    keys = ly_token_key_normalize(keys);
+
+    int32_t slot_index = ly_keyword_find_slot(spelling);
+    if (slot_index < 0 || 0 == (ly_keyword_slots[slot_index].key & keys)) {
+        return LY_TK_PP_NOT_KEYWORD;
+    }
+
+    return k_cast(ly_token_kind) ly_keyword_slots[slot_index].kind;
+}
+
+CHOIR_API ly_token_key ly_token_key_normalize(ly_token_key keys) {
+    if (0 != (keys & LY_TKKEY_C23)) {
+        keys |= LY_TKKEY_C99 | LY_TKKEY_BOOL;
+    }
+
+    if (0 != (keys & LY_TKKEY_C99)) {
+        keys |= LY_TKKEY_C;
+    }
+
+    if (0 != (keys & LY_TKKEY_MS_COMPAT)) {
+        keys |= LY_TKKEY_MS;
+    }
+
+    return keys;
+}
+
+/// The dialects of the built-in tables, already normalized; see ly_token_key_normalize.
+#define LY_KEYWORD_KEYS_C23  (LY_TKKEY_C23 | LY_TKKEY_C99 | LY_TKKEY_BOOL | LY_TKKEY_C)
+#define LY_KEYWORD_KEYS_LAYE (LY_TKKEY_LAYE)
+
+// Built at compile time from the generated slots, so every lexer in the process shares them without any of them building anything.
+// Slots without a keyword are left zero; a lookup never reaches them, since it only reads the slot of a keyword spelling.
+#define X(Slot, Id, Key) [Slot] = 0 != ((Key) & LY_KEYWORD_KEYS_C23) ? LY_TK_KW_##Id : LY_TK_PP_NOT_KEYWORD,
+static const ly_keyword_table ly_c23_keyword_table = {
+    .keys = LY_KEYWORD_KEYS_C23,
+    .kinds = {LY_KEYWORD_SLOTS(X)},
+};
+#undef X
+
+#define X(Slot, Id, Key) [Slot] = 0 != ((Key) & LY_KEYWORD_KEYS_LAYE) ? LY_TK_KW_##Id : LY_TK_PP_NOT_KEYWORD,
+static const ly_keyword_table ly_laye_keyword_table = {
+    .keys = LY_KEYWORD_KEYS_LAYE,
+    .kinds = {LY_KEYWORD_SLOTS(X)},
+};
+#undef X
+
+CHOIR_API const ly_keyword_table* ly_keyword_table_get_builtin(ly_token_key keys) {
+    keys = ly_token_key_normalize(keys);
+    if (keys == ly_c23_keyword_table.keys) {
+        return &ly_c23_keyword_table;
+    }
+
+    if (keys == ly_laye_keyword_table.keys) {
+        return &ly_laye_keyword_table;
+    }
+
+    return nullptr;
+}
+
+CHOIR_API const ly_keyword_table* ly_keyword_table_create(k_arena* arena, ly_token_key keys) {
+    assert(arena != nullptr);
+    keys = ly_token_key_normalize(keys);
+
+    ly_keyword_table* table = k_arena_alloc(arena, sizeof(ly_keyword_table));
+    table->keys = keys;
+    for (isize_t i = 0; i < LY_KEYWORD_HASH_SIZE; i++) {
+        const ly_keyword_slot* slot = &ly_keyword_slots[i];
+        table->kinds[i] = slot->length != 0 && 0 != (slot->key & keys) ? slot->kind : LY_TK_PP_NOT_KEYWORD;
+    }
+
+    return table;
+}
+
+CHOIR_API ly_token_kind ly_keyword_table_lookup(const ly_keyword_table* table, k_string_view spelling) {
+    int32_t slot_index = ly_keyword_find_slot(spelling);
+    if (slot_index < 0) {
+        return LY_TK_PP_NOT_KEYWORD;
+    }
+
+    return k_cast(ly_token_kind) table->kinds[slot_index];
+}
+
+CHOIR_API void ly_context_set_c_dialect(ch_context* context, ly_token_key keys) {
+    assert(context != nullptr);
+    keys = ly_token_key_normalize(keys);
+    assert(0 != (keys & LY_TKKEY_C) && 0 == (keys & LY_TKKEY_LAYE) && "A C dialect must include C and not Laye");
+
+    const ly_keyword_table* table = ly_keyword_table_get_builtin(keys);
+    if (table == nullptr) {
+        table = ly_keyword_table_create(context->string_arena, keys);
+    }
+
+    context->c_dialect_keys = keys;
+    context->c_keyword_table = table;
+}
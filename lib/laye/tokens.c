@@ -0,0 +1,279 @@
+#include <laye/core.h>
+
+static_assert(LY_TOKEN_KIND_COUNT <= UINT16_MAX, "Token kinds must fit in a token buffer");
+
+/// Every per-token array of a token buffer, in the order they are laid out in its storage.
+/// Larger elements come first, so every array starts suitably aligned whatever the capacity.
+#define LY_TOKENS_FIELDS(X) \
+    X(begins)               \
+    X(ends)                 \
+    X(data)                 \
+    X(kinds)                \
+    X(flags)
+
+/// The address space reserved for a token buffer's storage, which is only committed as it is used.
+#define LY_TOKENS_RESERVE_SIZE (k_cast(size_t) 4 << 30)
+
+/// The bytes one token takes across all of the per-token arrays.
+#define LY_TOKEN_RECORD_SIZE (sizeof(ch_location) + sizeof(ch_location) + sizeof(uint32_t) + sizeof(uint16_t) + sizeof(uint8_t))
+
+/// Returns true if tokens of this kind keep a value in the buffer's payload table.
+/// Identifiers and keywords are not among them; their interned spelling is stored inline instead.
+static bool ly_token_kind_has_payload(ly_token_kind kind) {
+    switch (kind) {
+        default: return false;
+
+        case LY_TK_PP_NUMBER:
+        case LY_TK_PP_LAYE_NUMBER:
+        case LY_TK_HEADER_NAME:
+        case LY_TK_INTEGER_CONSTANT:
+        case LY_TK_FLOATING_CONSTANT:
+        case LY_TK_CHARACTER_CONSTANT:
+        case LY_TK_WIDE_CHARACTER_CONSTANT:
+        case LY_TK_UTF8_CHARACTER_CONSTANT:
+        case LY_TK_UTF16_CHARACTER_CONSTANT:
+        case LY_TK_UTF32_CHARACTER_CONSTANT:
+        case LY_TK_STRING_LITERAL:
+        case LY_TK_WIDE_STRING_LITERAL:
+        case LY_TK_UTF8_STRING_LITERAL:
+        case LY_TK_UTF16_STRING_LITERAL:
+        case LY_TK_UTF32_STRING_LITERAL:
+            return true;
+    }
+}
+
+/// Returns true if the payload of tokens of this kind is a view of their text, rather than a value.
+static bool ly_token_kind_has_text_payload(ly_token_kind kind) {
+    switch (kind) {
+        default: return false;
+
+        case LY_TK_PP_NUMBER:
+        case LY_TK_PP_LAYE_NUMBER:
+        case LY_TK_HEADER_NAME:
+        case LY_TK_STRING_LITERAL:
+        case LY_TK_WIDE_STRING_LITERAL:
+        case LY_TK_UTF8_STRING_LITERAL:
+        case LY_TK_UTF16_STRING_LITERAL:
+        case LY_TK_UTF32_STRING_LITERAL:
+            return true;
+    }
+}
+
+CHOIR_API void ly_tokens_init(ly_tokens* tokens, ch_context* context) {
+    assert(tokens != nullptr);
+    assert(context != nullptr);
+
+    *tokens = (ly_tokens){
+        .context = context,
+        .payloads.arena = context->node_arena,
+    };
+
+    // Address space is cheap, so reserve enough that the storage block never has to move; without virtual memory this is an ordinary arena.
+    k_arena_init_virtual(&tokens->arena, LY_TOKENS_RESERVE_SIZE, K_ARENA_FLAGS_NONE);
+    k_arena_set_tag(&tokens->arena, "tokens");
+}
+
+CHOIR_API void ly_tokens_deinit(ly_tokens* tokens) {
+    assert(tokens != nullptr);
+    k_arena_deinit(&tokens->arena);
+    *tokens = (ly_tokens){0};
+}
+
+/// Point every per-token array into 'storage', laid out one after another for 'capacity' tokens.
+static void ly_tokens_carve(ly_tokens* tokens, char* storage, isize_t capacity) {
+#define X(Field)                                                   \
+    tokens->Field = k_cast(void*) storage;                         \
+    storage += k_cast(size_t) capacity * sizeof(*tokens->Field);
+    LY_TOKENS_FIELDS(X)
+#undef X
+}
+
+/// Grow every per-token array to hold at least 'capacity' tokens, to exactly that many if 'exact' is set.
+/// The arrays share one block, alone in the buffer's arena, so growing it is almost always in place: only the arrays after the first move, and only within the block.
+static void ly_tokens_grow(ly_tokens* tokens, isize_t capacity, bool exact) {
+    if (!exact) {
+        isize_t grown_capacity = tokens->capacity == 0 ? K_DA_INIT_CAP : (tokens->capacity * K_DA_GROWTH_NUMERATOR) / K_DA_GROWTH_DENOMINATOR;
+        if (grown_capacity > capacity) {
+            capacity = grown_capacity;
+        }
+    }
+
+    char* storage = k_cast(char*) tokens->begins;
+    size_t old_size = k_cast(size_t) tokens->capacity * LY_TOKEN_RECORD_SIZE;
+    size_t new_size = k_cast(size_t) capacity * LY_TOKEN_RECORD_SIZE;
+    ly_tokens old_tokens = *tokens;
+
+    if (storage != nullptr && k_arena_try_extend(&tokens->arena, storage, old_size, new_size)) {
+        ly_tokens_carve(tokens, storage, capacity);
+
+        // Every array moves up by more than the one after it, so moving the last first never overwrites one not moved yet.
+        memmove(tokens->flags, old_tokens.flags, k_cast(size_t) tokens->count * sizeof(*tokens->flags));
+        memmove(tokens->kinds, old_tokens.kinds, k_cast(size_t) tokens->count * sizeof(*tokens->kinds));
+        memmove(tokens->data, old_tokens.data, k_cast(size_t) tokens->count * sizeof(*tokens->data));
+        memmove(tokens->ends, old_tokens.ends, k_cast(size_t) tokens->count * sizeof(*tokens->ends));
+    } else {
+        ly_tokens_carve(tokens, k_arena_alloc_uninit(&tokens->arena, new_size), capacity);
+        if (storage != nullptr) {
+#define X(Field) memcpy(tokens->Field, old_tokens.Field, k_cast(size_t) tokens->count * sizeof(*tokens->Field));
+            LY_TOKENS_FIELDS(X)
+#undef X
+        }
+    }
+
+    tokens->capacity = capacity;
+}
+
+CHOIR_API void ly_tokens_reserve(ly_tokens* tokens, isize_t capacity) {
+    assert(tokens != nullptr);
+    if (tokens->capacity < capacity) {
+        ly_tokens_grow(tokens, capacity, true);
+    }
+}
+
+CHOIR_API void ly_tokens_push(ly_tokens* tokens, const ly_token* token) {
+    assert(tokens != nullptr);
+    assert(token != nullptr);
+
+    if (tokens->count >= tokens->capacity) {
+        ly_tokens_grow(tokens, tokens->count + 1, false);
+    }
+
+    isize_t index = tokens->count++;
+    tokens->kinds[index] = k_cast(uint16_t) token->kind;
+    tokens->flags[index] = k_cast(uint8_t)(
+        (token->at_start_of_line ? LY_TOKEN_FLAG_AT_START_OF_LINE : 0) |
+        (token->has_white_space_before ? LY_TOKEN_FLAG_HAS_WHITE_SPACE_BEFORE : 0) |
+        (token->expansion_disabled ? LY_TOKEN_FLAG_EXPANSION_DISABLED : 0)
+    );
+    tokens->begins[index] = token->range.begin;
+    tokens->ends[index] = token->range.end;
+
+    if (ly_token_kind_has_payload(token->kind)) {
+        assert(tokens->payloads.count < UINT32_MAX && "Buy more RAM lol");
+        tokens->data[index] = k_cast(uint32_t) tokens->payloads.count;
+
+        // Only the union is copied, which is every value any of these kinds can have.
+        ly_token_payload payload;
+        static_assert(sizeof(payload) == sizeof(token->string_literal), "A token payload must be exactly the size of a token's value");
+        memcpy(&payload, &token->string_literal, sizeof(payload));
+        k_da_push(&tokens->payloads, payload);
+    } else {
+        tokens->data[index] = token->text_id;
+    }
+}
+
+CHOIR_API void ly_tokens_append(ly_tokens* tokens, const ly_tokens* other, k_intern_id* text_id_map) {
+    assert(tokens != nullptr);
+    assert(other != nullptr);
+
+    bool is_same_context = tokens->context == other->context;
+    assert((is_same_context || text_id_map != nullptr) && "Appending tokens from another context needs a map of its intern handles");
+
+    if (tokens->capacity < tokens->count + other->count) {
+        ly_tokens_grow(tokens, tokens->count + other->count, false);
+    }
+
+    // Payloads are in token order, so the first token with one says where the payloads of these tokens begin;
+    // 'other' can be a view of the tail of another buffer, whose earlier payloads are not wanted.
+    uint32_t payload_first = k_cast(uint32_t) other->payloads.count;
+    for (isize_t i = 0; i < other->count; i++) {
+        if (ly_token_kind_has_payload(other->kinds[i])) {
+            payload_first = other->data[i];
+            break;
+        }
+    }
+
+    isize_t base = tokens->count;
+    uint32_t payload_delta = k_cast(uint32_t) tokens->payloads.count - payload_first;
+    memcpy(tokens->kinds + base, other->kinds, k_cast(size_t) other->count * sizeof(*tokens->kinds));
+    memcpy(tokens->flags + base, other->flags, k_cast(size_t) other->count * sizeof(*tokens->flags));
+    memcpy(tokens->begins + base, other->begins, k_cast(size_t) other->count * sizeof(*tokens->begins));
+    memcpy(tokens->ends + base, other->ends, k_cast(size_t) other->count * sizeof(*tokens->ends));
+    if (other->payloads.count > payload_first) {
+        k_da_push_many(&tokens->payloads, other->payloads.data + payload_first, other->payloads.count - payload_first);
+    }
+
+    ch_context* context = tokens->context;
+    for (isize_t i = 0; i < other->count; i++) {
+        ly_token_kind kind = other->kinds[i];
+        uint32_t data = other->data[i];
+
+        if (ly_token_kind_has_payload(kind)) {
+            // Unsigned wrapping makes this right even when the payloads start later here than they do there.
+            data += payload_delta;
+
+            // Text in the other context's arenas will not outlive it, unlike text in the source itself.
+            if (!is_same_context && ly_token_kind_has_text_payload(kind)) {
+                k_string_view* text = &tokens->payloads.data[data].text_value;
+                ch_source* source = ch_context_get_source(context, other->begins[i]);
+                bool is_source_text = source != nullptr && text->data >= source->text.data && text->data + text->count <= source->text.data + source->text.count;
+                if (!is_source_text && text->count != 0) {
+                    char* copy = k_arena_alloc_uninit(context->string_arena, k_cast(size_t) text->count);
+                    memcpy(copy, text->data, k_cast(size_t) text->count);
+                    text->data = copy;
+                }
+            }
+        } else if (data != K_INTERN_ID_NONE && !is_same_context) {
+            if (text_id_map[data] == K_INTERN_ID_NONE) {
+                text_id_map[data] = k_intern(&context->intern_table, k_intern_get(&other->context->intern_table, data));
+            }
+
+            data = text_id_map[data];
+        }
+
+        tokens->data[base + i] = data;
+    }
+
+    tokens->count += other->count;
+}
+
+CHOIR_API ly_token ly_tokens_get(const ly_tokens* tokens, isize_t index) {
+    assert(tokens != nullptr);
+    assert(index >= 0 && index < tokens->count);
+
+    ly_token_flags flags = tokens->flags[index];
+    ly_token token = {
+        .kind = tokens->kinds[index],
+        .at_start_of_line = 0 != (flags & LY_TOKEN_FLAG_AT_START_OF_LINE),
+        .has_white_space_before = 0 != (flags & LY_TOKEN_FLAG_HAS_WHITE_SPACE_BEFORE),
+        .expansion_disabled = 0 != (flags & LY_TOKEN_FLAG_EXPANSION_DISABLED),
+        .range = ly_tokens_range(tokens, index),
+    };
+
+    if (ly_token_kind_has_payload(token.kind)) {
+        ly_token_payload payload = tokens->payloads.data[tokens->data[index]];
+        memcpy(&token.string_literal, &payload, sizeof(payload));
+    } else if (tokens->data[index] != K_INTERN_ID_NONE) {
+        token.text_id = tokens->data[index];
+        token.text_value = k_intern_get(&tokens->context->intern_table, token.text_id);
+    }
+
+    return token;
+}
+
+CHOIR_API ly_token_kind ly_tokens_kind(const ly_tokens* tokens, isize_t index) {
+    assert(tokens != nullptr);
+    assert(index >= 0 && index < tokens->count);
+    return k_cast(ly_token_kind) tokens->kinds[index];
+}
+
+CHOIR_API ly_token_flags ly_tokens_flags(const ly_tokens* tokens, isize_t index) {
+    assert(tokens != nullptr);
+    assert(index >= 0 && index < tokens->count);
+    return k_cast(ly_token_flags) tokens->flags[index];
+}
+
+CHOIR_API ch_range ly_tokens_range(const ly_tokens* tokens, isize_t index) {
+    assert(tokens != nullptr);
+    assert(index >= 0 && index < tokens->count);
+    return (ch_range){
+        .begin = tokens->begins[index],
+        .end = tokens->ends[index],
+    };
+}
+
+CHOIR_API k_intern_id ly_tokens_text_id(const ly_tokens* tokens, isize_t index) {
+    assert(tokens != nullptr);
+    assert(index >= 0 && index < tokens->count);
+    return ly_token_kind_has_payload(k_cast(ly_token_kind) tokens->kinds[index]) ? K_INTERN_ID_NONE : tokens->data[index];
+}
@@ -13,6 +13,12 @@
 #define LAYEC_EXECUTABLE_FILE "layec"
 #define CCLY_EXECUTABLE_FILE  "ccly"
 
+#define GEN_LY_KEYWORDS_EXECUTABLE_FILE "gen_ly_keywords"
+#define LY_KEYWORDS_INCLUDE_FILE        ODIR "/laye-keywords.inc"
+
+#define GEN_LY_PUNCTUATORS_EXECUTABLE_FILE "gen_ly_punctuators"
+#define LY_PUNCTUATORS_INCLUDE_FILE        ODIR "/laye-punctuators.inc"
+
 #if defined(NOBCONFIG_MISSING)
 #    error No nob configuration has been specified. Please copy the relevant config file from the config directory for your platform and toolchain into the appropriate '<PLATFORM>.h' file.
 #endif
@@ -27,17 +33,25 @@ typedef struct {
 
 static source_paths libchoir_files[] = {
     {"lib/kos/arena.c", ODIR "/kos-arena.o"},
+    {"lib/kos/da.c", ODIR "/kos-da.o"},
     {"lib/kos/diag.c", ODIR "/kos-diag.o"},
+    {"lib/kos/intern.c", ODIR "/kos-intern.o"},
+    {"lib/kos/pool.c", ODIR "/kos-pool.o"},
     {"lib/kos/string.c", ODIR "/kos-string.o"},
+    {"lib/kos/thread.c", ODIR "/kos-thread.o"},
     {"lib/kos/unicode.c", ODIR "/kos-unicode.o"},
 
     {"lib/choir/context.c", ODIR "/choir-context.o"},
     {"lib/choir/size_align.c", ODIR "/choir-size_align.o"},
+    {"lib/choir/source.c", ODIR "/choir-source.o"},
 
     {"lib/laye/diag.c", ODIR "/laye-diag.o"},
     {"lib/laye/lex.c", ODIR "/laye-lex.o"},
+    {"lib/laye/lex.parallel.c", ODIR "/laye-lex-parallel.o"},
     {"lib/laye/pp.core.c", ODIR "/laye-pp-core.o"},
+    {"lib/laye/source.c", ODIR "/laye-source.o"},
     {"lib/laye/token.c", ODIR "/laye-token.o"},
+    {"lib/laye/tokens.c", ODIR "/laye-tokens.o"},
 
     {0},
 };
@@ -57,6 +71,29 @@ static source_paths choir_files[] = {
     {0},
 };
 
+/// Each test program is its own executable, named after its object file, and linked against libchoir.
+static source_paths test_files[] = {
+    {"test/kos_test.c", ODIR "/kos_test.o"},
+    {"test/laye_test.c", ODIR "/laye_test.o"},
+    {0},
+};
+
+static source_paths benchmark_files[] = {
+    {"test/arena_benchmark.c", ODIR "/arena_benchmark.o"},
+    {"test/lex_benchmark.c", ODIR "/lex_benchmark.o"},
+    {0},
+};
+
+static source_paths gen_ly_keywords_files[] = {
+    {"src/gen_ly_keywords.c", ODIR "/gen_ly_keywords.o"},
+    {0},
+};
+
+static source_paths gen_ly_punctuators_files[] = {
+    {"src/gen_ly_punctuators.c", ODIR "/gen_ly_punctuators.o"},
+    {0},
+};
+
 static Nob_File_Paths all_header_files = {0};
 
 static bool compile_object(const char* source_path, const char* object_path, const char* source_root) {
@@ -73,10 +110,12 @@ static bool compile_object(const char* source_path, const char* object_path, con
     nob_cmd_append(&cmd, "/c", source_path);
     nob_cmd_append(&cmd, nob_temp_sprintf("/Fo%s", object_path));
     nob_cmd_append(&cmd, nob_temp_sprintf("/I%s/include", source_root));
+    nob_cmd_append(&cmd, "/I" ODIR);
 #else // !CC_MSVC
     nob_cmd_append(&cmd, "-c", source_path);
     nob_cmd_append(&cmd, "-o", object_path);
     nob_cmd_append(&cmd, nob_temp_sprintf("-I%s/include", source_root));
+    nob_cmd_append(&cmd, "-I" ODIR);
 #endif
     nob_cmd_append(&cmd, "" CFLAGS "");
 
@@ -143,6 +182,24 @@ defer:;
     return result;
 }
 
+static bool run_generator(const char* generator_path, const char* output_path) {
+    bool result = true;
+
+    Nob_Cmd cmd = {0};
+    if (0 == nob_needs_rebuild1(output_path, generator_path)) {
+        nob_return_defer(true);
+    }
+
+    nob_cmd_append(&cmd, generator_path, output_path);
+    if (!nob_cmd_run_sync(cmd)) {
+        nob_return_defer(false);
+    }
+
+defer:;
+    nob_cmd_free(cmd);
+    return result;
+}
+
 static void clean(void) {
     if (nob_file_exists("./choir")) remove("./choir");
     if (nob_file_exists("./choir.exe")) remove("./choir.exe");
@@ -178,6 +235,69 @@ defer:
     return result;
 }
 
+/// Builds every program in 'files' against 'libfile', and runs each of them if 'run' is set.
+static bool build_test_programs(const char* source_root, source_paths* files, const char* libfile, bool run) {
+    bool result = true;
+
+    Nob_File_Paths input_paths = {0};
+    for (int64_t i = 0; files[i].source_file != 0; i++) {
+        const char* source_file = nob_temp_sprintf("%s/%s", source_root, files[i].source_file);
+        if (!compile_object(source_file, files[i].object_file, source_root)) {
+            nob_return_defer(false);
+        }
+
+        const char* object_file = files[i].object_file;
+        const char* executable_file = nob_temp_sprintf("%.*s" EXE_EXT, (int)(strlen(object_file) - 2), object_file);
+
+        input_paths.count = 0;
+        nob_da_append(&input_paths, object_file);
+        nob_da_append(&input_paths, libfile);
+        if (!link_executable(input_paths, executable_file)) {
+            nob_return_defer(false);
+        }
+
+        if (run) {
+            Nob_Cmd cmd = {0};
+            nob_cmd_append(&cmd, executable_file);
+            bool passed = nob_cmd_run_sync(cmd);
+            nob_cmd_free(cmd);
+
+            // Keep going, so one run reports every failing program.
+            if (!passed) {
+                result = false;
+            }
+        }
+    }
+
+defer:;
+    nob_da_free(input_paths);
+    return result;
+}
+
+/// Builds the generator in 'files' and runs it to produce 'output_path', which is then tracked like any other header.
+static bool build_and_run_generator(const char* source_root, source_paths* files, const char* generator_path, const char* output_path) {
+    bool result = true;
+
+    Nob_File_Paths input_paths = {0};
+    if (!build_object_files(source_root, files, &input_paths)) {
+        nob_return_defer(false);
+    }
+
+    if (!link_executable(input_paths, generator_path)) {
+        nob_return_defer(false);
+    }
+
+    if (!run_generator(generator_path, output_path)) {
+        nob_return_defer(false);
+    }
+
+    nob_da_append(&all_header_files, output_path);
+
+defer:;
+    nob_da_free(input_paths);
+    return result;
+}
+
 // The implementation idea is stolen from https://github.com/zhiayang/nabs
 static void _go_rebuild_urself(const char* source_path, int argc, char** argv) {
     const char* binary_path = nob_shift(argv, argc);
@@ -223,11 +343,17 @@ int main(int argc, char** argv) {
 
     const char* program_name = nob_shift_args(&argc, &argv);
 
+    bool run_tests = false;
+    bool run_benchmarks = false;
     if (argc > 0) {
         const char* arg = nob_shift_args(&argc, &argv);
         if (0 == strcmp(arg, "clean")) {
             clean();
             nob_return_defer(0);
+        } else if (0 == strcmp(arg, "test")) {
+            run_tests = true;
+        } else if (0 == strcmp(arg, "bench")) {
+            run_benchmarks = true;
         }
     }
 
@@ -245,7 +371,9 @@ int main(int argc, char** argv) {
         nob_return_defer(1);
     }
 
-    for (size_t i = 2; i < include_file_paths.count; i++) {
+    for (size_t i = 0; i < include_file_paths.count; i++) {
+        // Directory entries come in no particular order, so '.' and '..' have to be skipped by name.
+        if (include_file_paths.items[i][0] == '.') continue;
         nob_da_append(&all_header_files, nob_temp_sprintf("%s/include/choir/%s", source_root, include_file_paths.items[i]));
     }
 
@@ -254,12 +382,35 @@ int main(int argc, char** argv) {
         nob_return_defer(1);
     }
 
-    for (size_t i = 2; i < include_file_paths.count; i++) {
+    for (size_t i = 0; i < include_file_paths.count; i++) {
+        if (include_file_paths.items[i][0] == '.') continue;
         nob_da_append(&all_header_files, nob_temp_sprintf("%s/include/kos/%s", source_root, include_file_paths.items[i]));
     }
 
+    include_file_paths.count = 0;
+    if (!nob_read_entire_dir(nob_temp_sprintf("%s/include/laye", source_root), &include_file_paths)) {
+        nob_return_defer(1);
+    }
+
+    for (size_t i = 0; i < include_file_paths.count; i++) {
+        if (include_file_paths.items[i][0] == '.') continue;
+        nob_da_append(&all_header_files, nob_temp_sprintf("%s/include/laye/%s", source_root, include_file_paths.items[i]));
+    }
+
     nob_da_free(include_file_paths);
 
+    // The keyword recognizer's perfect hash table and the punctuator tables are generated from <laye/tokens.h> before anything that includes them is compiled.
+    if (!build_and_run_generator(source_root, gen_ly_keywords_files, ODIR "/" GEN_LY_KEYWORDS_EXECUTABLE_FILE EXE_EXT, LY_KEYWORDS_INCLUDE_FILE)) {
+        nob_return_defer(1);
+    }
+
+    if (!build_and_run_generator(source_root, gen_ly_punctuators_files, ODIR "/" GEN_LY_PUNCTUATORS_EXECUTABLE_FILE EXE_EXT, LY_PUNCTUATORS_INCLUDE_FILE)) {
+        nob_return_defer(1);
+    }
+
+    // The XID tables are generated by hand from the Unicode database, so they are checked in rather than built.
+    nob_da_append(&all_header_files, nob_temp_sprintf("%s/lib/kos/unicode-xid.inc", source_root));
+
     Nob_File_Paths libchoir_object_paths = {0};
     if (!build_object_files(source_root, libchoir_files, &libchoir_object_paths)) {
         nob_return_defer(1);
@@ -303,6 +454,15 @@ int main(int argc, char** argv) {
         nob_return_defer(1);
     }
 
+    // Tests and benchmarks are always built, so they never fall behind the library, but only run when asked for.
+    if (!build_test_programs(source_root, test_files, libfile, run_tests)) {
+        nob_return_defer(1);
+    }
+
+    if (!build_test_programs(source_root, benchmark_files, libfile, run_benchmarks)) {
+        nob_return_defer(1);
+    }
+
     if (1 == nob_needs_rebuild1(LAYEC_EXECUTABLE_FILE EXE_EXT, layecfile)) {
         if (!nob_copy_file(layecfile, LAYEC_EXECUTABLE_FILE EXE_EXT)) {
             nob_return_defer(1);
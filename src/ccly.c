@@ -2,18 +2,66 @@
 #include <choir/core.h>
 #include <laye/core.h>
 
+/// Read the C dialect of a -std= option, as GCC and Clang spell them.
+/// Returns false for standards it does not know, which are ignored like any other unknown argument.
+static bool ccly_parse_c_standard(const char* name, ly_token_key* out_keys) {
+    ly_token_key keys = LY_TKKEY_NOT_KW;
+    if (0 == strncmp(name, "gnu", 3)) {
+        keys |= LY_TKKEY_GNU;
+        name += 3;
+    } else if (0 == strncmp(name, "c", 1)) {
+        name += 1;
+    } else {
+        return false;
+    }
+
+    if (0 == strcmp(name, "89") || 0 == strcmp(name, "90")) {
+        keys |= LY_TKKEY_C;
+    } else if (0 == strcmp(name, "99") || 0 == strcmp(name, "11") || 0 == strcmp(name, "17") || 0 == strcmp(name, "18")) {
+        keys |= LY_TKKEY_C99;
+    } else if (0 == strcmp(name, "23") || 0 == strcmp(name, "2x")) {
+        keys |= LY_TKKEY_C23;
+    } else {
+        return false;
+    }
+
+    *out_keys = keys;
+    return true;
+}
+
 int main(int argc, char** argv) {
+    bool print_memory_report = false;
+    ly_token_key c_dialect = LY_TKKEY_C23;
+    for (int i = 1; i < argc; i++) {
+        if (0 == strcmp(argv[i], "-fmem-report")) {
+            print_memory_report = true;
+        } else if (0 == strncmp(argv[i], "-std=", 5)) {
+            k_discard ccly_parse_c_standard(argv[i] + 5, &c_dialect);
+        }
+    }
+
     k_arena string_arena = {0};
     k_arena_init(&string_arena);
+    k_arena_set_tag(&string_arena, "strings");
+
+    k_arena node_arena = {0};
+    k_arena_init(&node_arena);
+    k_arena_set_tag(&node_arena, "nodes");
+
+    // Diagnostics get an arena of their own so their memory is accounted for separately.
+    k_arena diag_arena = {0};
+    k_arena_init(&diag_arena);
+    k_arena_set_tag(&diag_arena, "diagnostics");
 
     k_diag diag = {0};
     k_diag_formatted_state diag_userdata = {
         .output_stream = stderr,
     };
-    k_diag_init(&diag, &string_arena, k_diag_formatted, &diag_userdata);
+    k_diag_init(&diag, &diag_arena, k_diag_formatted, &diag_userdata);
 
     ch_context context = {0};
-    ch_context_init(&context, &diag, &string_arena);
+    ch_context_init(&context, &diag, &string_arena, &node_arena);
+    ly_context_set_c_dialect(&context, c_dialect);
 
     ch_source source = {
         .name = K_SV_CONST("foo.c"),
@@ -23,13 +71,29 @@ int main(int argc, char** argv) {
     ly_lexer lexer = {0};
     ly_lexer_init(&lexer, &context, &source, LY_LEXMODE_C);
 
+    ly_tokens tokens = {0};
+    ly_tokens_init(&tokens, &context);
+
     while (lexer.current_codepoint != 0) {
         ly_token token = ly_lexer_read_pp_token(&lexer);
-        fprintf(stderr, "%s\n", ly_token_kind_get_name(token.kind));
+        ly_tokens_push(&tokens, &token);
+    }
+
+    for (isize_t i = 0; i < tokens.count; i++) {
+        fprintf(stderr, "%s\n", ly_token_kind_get_name(ly_tokens_kind(&tokens, i)));
+    }
+
+    if (print_memory_report) {
+        ch_context_print_memory_report(&context, stderr);
+        k_arena_print_stats(&tokens.arena, stderr);
     }
 
+    ly_tokens_deinit(&tokens);
+
 defer:;
     k_diag_deinit(&diag);
+    k_arena_deinit(&diag_arena);
+    k_arena_deinit(&node_arena);
     k_arena_deinit(&string_arena);
     return 0;
 }
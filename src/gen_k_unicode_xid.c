@@ -0,0 +1,216 @@
+/// Generator for the XID_Start and XID_Continue tables in lib/kos/unicode.c.
+/// Reads DerivedCoreProperties.txt from the Unicode Character Database and writes a three-level bitmap trie of both properties, which lib/kos/unicode.c includes.
+/// Not run by the build, since the database is not part of the tree; rerun it by hand when moving to a new Unicode version.
+/// usage: gen_k_unicode_xid <DerivedCoreProperties.txt> <output-file>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CODEPOINT_COUNT 0x110000
+
+/// Codepoints per leaf; each leaf is one 64-bit word holding XID_Start in its low half and XID_Continue in its high half.
+#define LEAF_SIZE 32
+/// Leaves per block; the first level maps each (LEAF_SIZE * BLOCK_SIZE)-codepoint page to a block of leaf indices.
+#define BLOCK_SIZE 8
+#define PAGE_SIZE (LEAF_SIZE * BLOCK_SIZE)
+
+/// Past this many ranges of codepoints beyond the trie, the generated range scan is no longer cheap enough.
+#define MAX_HIGH_RANGES 8
+
+static bool is_xid_start[CODEPOINT_COUNT];
+static bool is_xid_continue[CODEPOINT_COUNT];
+
+static uint64_t leaves[CODEPOINT_COUNT / LEAF_SIZE];
+static size_t leaf_count;
+
+static uint16_t blocks[CODEPOINT_COUNT / LEAF_SIZE];
+static size_t block_count;
+
+static uint8_t pages[CODEPOINT_COUNT / PAGE_SIZE];
+
+/// Reads both properties from 'file', and the database version from its header line into 'version', which must hold at least 64 characters.
+static bool parse_properties(FILE* file, char* version) {
+    char line[1024];
+    while (fgets(line, sizeof line, file) != NULL) {
+        // The first line names the file, including the version of the database it belongs to.
+        if (version[0] == 0 && 1 == sscanf(line, "# DerivedCoreProperties-%63[0-9.].txt", version)) {
+            size_t length = strlen(version);
+            if (length > 0 && version[length - 1] == '.') version[length - 1] = 0;
+            continue;
+        }
+
+        char* comment = strchr(line, '#');
+        if (comment != NULL) *comment = 0;
+
+        unsigned long first, last;
+        char property[64];
+        if (3 == sscanf(line, "%lx..%lx ; %63s", &first, &last, property)) {
+        } else if (2 == sscanf(line, "%lx ; %63s", &first, property)) {
+            last = first;
+        } else continue;
+
+        if (first > last || last >= CODEPOINT_COUNT) {
+            return false;
+        }
+
+        bool* values = NULL;
+        if (0 == strcmp(property, "XID_Start")) values = is_xid_start;
+        else if (0 == strcmp(property, "XID_Continue")) values = is_xid_continue;
+        else continue;
+
+        for (unsigned long c = first; c <= last; c++) {
+            values[c] = true;
+        }
+    }
+
+    return true;
+}
+
+static uint64_t leaf_at(size_t first) {
+    uint64_t leaf = 0;
+    for (size_t i = 0; i < LEAF_SIZE; i++) {
+        if (is_xid_start[first + i]) leaf |= (uint64_t)1 << i;
+        if (is_xid_continue[first + i]) leaf |= (uint64_t)1 << (32 + i);
+    }
+
+    return leaf;
+}
+
+static size_t intern_leaf(uint64_t leaf) {
+    for (size_t i = 0; i < leaf_count; i++) {
+        if (leaves[i] == leaf) return i;
+    }
+
+    leaves[leaf_count] = leaf;
+    return leaf_count++;
+}
+
+static size_t intern_block(const uint16_t* block) {
+    for (size_t i = 0; i < block_count; i++) {
+        if (0 == memcmp(&blocks[i * BLOCK_SIZE], block, sizeof(uint16_t) * BLOCK_SIZE)) return i;
+    }
+
+    memcpy(&blocks[block_count * BLOCK_SIZE], block, sizeof(uint16_t) * BLOCK_SIZE);
+    return block_count++;
+}
+
+int main(int argc, char** argv) {
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s <DerivedCoreProperties.txt> <output-file>\n", argv[0]);
+        return 1;
+    }
+
+    FILE* input = fopen(argv[1], "r");
+    if (input == NULL) {
+        fprintf(stderr, "%s: could not open '%s' for reading\n", argv[0], argv[1]);
+        return 1;
+    }
+
+    char version[64] = {0};
+    bool parsed = parse_properties(input, version);
+    fclose(input);
+
+    if (!parsed) {
+        fprintf(stderr, "%s: '%s' has a codepoint range out of bounds\n", argv[0], argv[1]);
+        return 1;
+    }
+
+    // The trie covers everything up to the last XID_Start codepoint; past that, the only identifier characters are a few ranges of combining marks, which are cheaper to list.
+    size_t limit = 0;
+    for (size_t c = 0; c < CODEPOINT_COUNT; c++) {
+        if (is_xid_start[c]) limit = c + 1;
+    }
+
+    limit = (limit + PAGE_SIZE - 1) / PAGE_SIZE * PAGE_SIZE;
+    if (limit == 0) {
+        fprintf(stderr, "%s: '%s' has no XID_Start codepoints\n", argv[0], argv[1]);
+        return 1;
+    }
+
+    unsigned long high_ranges[MAX_HIGH_RANGES][2];
+    size_t high_range_count = 0;
+    for (size_t c = limit; c < CODEPOINT_COUNT; c++) {
+        if (!is_xid_continue[c]) continue;
+
+        if (high_range_count > 0 && high_ranges[high_range_count - 1][1] == c - 1) {
+            high_ranges[high_range_count - 1][1] = c;
+            continue;
+        }
+
+        if (high_range_count == MAX_HIGH_RANGES) {
+            fprintf(stderr, "%s: too many XID_Continue ranges past U+%04zX\n", argv[0], limit);
+            return 1;
+        }
+
+        high_ranges[high_range_count][0] = c;
+        high_ranges[high_range_count][1] = c;
+        high_range_count++;
+    }
+
+    // The empty leaf and block come first, so that the zero index means "nothing here".
+    intern_leaf(0);
+    uint16_t empty_block[BLOCK_SIZE] = {0};
+    intern_block(empty_block);
+
+    for (size_t page = 0; page < limit / PAGE_SIZE; page++) {
+        uint16_t block[BLOCK_SIZE];
+        for (size_t i = 0; i < BLOCK_SIZE; i++) {
+            block[i] = (uint16_t)intern_leaf(leaf_at(page * PAGE_SIZE + i * LEAF_SIZE));
+        }
+
+        size_t block_index = intern_block(block);
+        if (block_index > UINT8_MAX) {
+            fprintf(stderr, "%s: more than 256 distinct blocks; the first level needs to be wider\n", argv[0]);
+            return 1;
+        }
+
+        pages[page] = (uint8_t)block_index;
+    }
+
+    FILE* out = fopen(argv[2], "w");
+    if (out == NULL) {
+        fprintf(stderr, "%s: could not open '%s' for writing\n", argv[0], argv[2]);
+        return 1;
+    }
+
+    fprintf(out, "// Generated by src/gen_k_unicode_xid.c from DerivedCoreProperties.txt (Unicode %s); do not edit.\n\n", version[0] != 0 ? version : "unknown version");
+    fprintf(out, "#define K_UNICODE_XID_LEAF_SIZE %d\n", LEAF_SIZE);
+    fprintf(out, "#define K_UNICODE_XID_BLOCK_SIZE %d\n", BLOCK_SIZE);
+    fprintf(out, "#define K_UNICODE_XID_PAGE_SIZE %d\n", PAGE_SIZE);
+    fprintf(out, "#define K_UNICODE_XID_TRIE_LIMIT 0x%zX\n\n", limit);
+
+    fprintf(out, "static const uint8_t k_unicode_xid_pages[K_UNICODE_XID_TRIE_LIMIT / K_UNICODE_XID_PAGE_SIZE] = {");
+    for (size_t i = 0; i < limit / PAGE_SIZE; i++) {
+        fprintf(out, "%s%u,", i % 16 == 0 ? "\n    " : " ", pages[i]);
+    }
+    fprintf(out, "\n};\n\n");
+
+    fprintf(out, "static const uint16_t k_unicode_xid_blocks[%zu * K_UNICODE_XID_BLOCK_SIZE] = {", block_count);
+    for (size_t i = 0; i < block_count * BLOCK_SIZE; i++) {
+        fprintf(out, "%s%u,", i % BLOCK_SIZE == 0 ? "\n    " : " ", blocks[i]);
+    }
+    fprintf(out, "\n};\n\n");
+
+    fprintf(out, "static const uint64_t k_unicode_xid_leaves[%zu] = {", leaf_count);
+    for (size_t i = 0; i < leaf_count; i++) {
+        fprintf(out, "%s0x%016llXull,", i % 4 == 0 ? "\n    " : " ", (unsigned long long)leaves[i]);
+    }
+    fprintf(out, "\n};\n\n");
+
+    fprintf(out, "static const int32_t k_unicode_xid_continue_high_ranges[%zu][2] = {\n", high_range_count);
+    for (size_t i = 0; i < high_range_count; i++) {
+        fprintf(out, "    {0x%04lX, 0x%04lX},\n", high_ranges[i][0], high_ranges[i][1]);
+    }
+    fprintf(out, "};\n");
+
+    if (0 != fclose(out)) {
+        fprintf(stderr, "%s: could not write '%s'\n", argv[0], argv[2]);
+        return 1;
+    }
+
+    fprintf(stderr, "%s: %zu pages, %zu blocks, %zu leaves, %zu bytes of tables\n", argv[0], limit / PAGE_SIZE, block_count, leaf_count, limit / PAGE_SIZE + block_count * BLOCK_SIZE * 2 + leaf_count * 8 + high_range_count * 8);
+    return 0;
+}
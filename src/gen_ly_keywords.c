@@ -0,0 +1,171 @@
+/// Build-time generator for the Laye/C keyword recognizer.
+/// Reads the CH_KEYWORD entries of <laye/tokens.h> and writes a perfect hash table of them, which lib/laye/token.c includes.
+/// Run by nob as part of the build; usage: gen_ly_keywords <output-file>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct keyword {
+    const char* id;
+    const char* spelling;
+    const char* flags;
+    size_t length;
+    /// The first and last eight bytes of the keyword as little-endian words, zero padded if it is shorter; these overlap if it is shorter than 16 bytes.
+    uint64_t head, tail;
+} keyword;
+
+static uint64_t load_word(const char* data, size_t count) {
+    uint64_t word = 0;
+    for (size_t i = 0; i < count && i < 8; i++) {
+        word |= (uint64_t)(unsigned char)data[i] << (i * 8);
+    }
+
+    return word;
+}
+
+static keyword keywords[] = {
+#define CH_KEYWORD(Id, Spelling, Flags) {#Id, Spelling, #Flags, 0, 0, 0},
+#include <laye/tokens.h>
+};
+
+#define KEYWORD_COUNT (sizeof(keywords) / sizeof(keywords[0]))
+
+/// The number of multiplier pairs tried per table size before moving on to a larger table.
+#define MAX_ATTEMPTS (1 << 22)
+
+/// Must match the hash the generated LY_KEYWORD_HASH macro computes.
+static uint32_t keyword_hash(const keyword* kw, uint64_t head_multiplier, uint64_t tail_multiplier, int bits) {
+    return (uint32_t)((kw->head * head_multiplier + (kw->tail ^ kw->length) * tail_multiplier) >> (64 - bits));
+}
+
+static bool try_hash(uint64_t head_multiplier, uint64_t tail_multiplier, int bits, unsigned char* used) {
+    memset(used, 0, (size_t)1 << bits);
+    for (size_t i = 0; i < KEYWORD_COUNT; i++) {
+        if (keywords[i].spelling == NULL) continue;
+
+        uint32_t slot = keyword_hash(&keywords[i], head_multiplier, tail_multiplier, bits);
+        if (used[slot]) return false;
+        used[slot] = 1;
+    }
+
+    return true;
+}
+
+/// A fixed-seed generator keeps the output identical from build to build.
+static uint64_t next_random(uint64_t* state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s <output-file>\n", argv[0]);
+        return 1;
+    }
+
+    size_t keyword_count = 0;
+    size_t max_length = 0;
+    for (size_t i = 0; i < KEYWORD_COUNT; i++) {
+        if (keywords[i].spelling == NULL) continue;
+
+        keyword* kw = &keywords[i];
+        kw->length = strlen(kw->spelling);
+
+        kw->head = load_word(kw->spelling, kw->length);
+        kw->tail = kw->length <= 8 ? kw->head : load_word(kw->spelling + kw->length - 8, 8);
+
+        keyword_count++;
+        if (kw->length > max_length) max_length = kw->length;
+
+        for (size_t j = 0; j < i; j++) {
+            if (keywords[j].spelling != NULL && 0 == strcmp(kw->spelling, keywords[j].spelling)) {
+                fprintf(stderr, "%s: keywords %s and %s are both spelled '%s'\n", argv[0], keywords[j].id, kw->id, kw->spelling);
+                return 1;
+            }
+        }
+    }
+
+    // Search for the smallest table which some pair of odd multipliers places every keyword in a slot of its own.
+    // Below four slots per keyword the odds of a random pair doing so are too slim to be worth trying.
+    static unsigned char used[1 << 16];
+    uint64_t random_state = 0;
+    uint64_t head_multiplier = 0, tail_multiplier = 0;
+    uint32_t size = 0;
+    int bits = 1;
+    while (((size_t)1 << bits) < keyword_count * 4) bits++;
+    for (; bits <= 16 && size == 0; bits++) {
+        for (int attempt = 0; attempt < MAX_ATTEMPTS && size == 0; attempt++) {
+            uint64_t head_candidate = next_random(&random_state) | 1;
+            uint64_t tail_candidate = next_random(&random_state) | 1;
+            if (try_hash(head_candidate, tail_candidate, bits, used)) {
+                head_multiplier = head_candidate, tail_multiplier = tail_candidate, size = (uint32_t)1 << bits;
+            }
+        }
+    }
+
+    bits--;
+
+    if (size == 0) {
+        fprintf(stderr, "%s: no perfect hash found for the keywords in <laye/tokens.h>\n", argv[0]);
+        return 1;
+    }
+
+    FILE* out = fopen(argv[1], "w");
+    if (out == NULL) {
+        fprintf(stderr, "%s: could not open '%s' for writing\n", argv[0], argv[1]);
+        return 1;
+    }
+
+    fprintf(out, "// Generated by src/gen_ly_keywords.c from include/laye/tokens.h; do not edit.\n\n");
+    fprintf(out, "#define LY_KEYWORD_MAX_LENGTH %zu\n", max_length);
+    fprintf(out, "#define LY_KEYWORD_HASH_SIZE %u\n", size);
+    fprintf(
+        out,
+        "#define LY_KEYWORD_HASH(Head, Tail, Length) ((uint32_t)(((Head) * 0x%016llXull + ((Tail) ^ (uint64_t)(Length)) * 0x%016llXull) >> %d))\n\n",
+        (unsigned long long)head_multiplier,
+        (unsigned long long)tail_multiplier,
+        64 - bits
+    );
+
+    fprintf(out, "static const ly_keyword_slot ly_keyword_slots[LY_KEYWORD_HASH_SIZE] = {\n");
+    for (size_t i = 0; i < KEYWORD_COUNT; i++) {
+        const keyword* kw = &keywords[i];
+        if (kw->spelling == NULL) continue;
+
+        fprintf(
+            out,
+            "    [%u] = {.head = 0x%016llXull, .tail = 0x%016llXull, .kind = LY_TK_KW_%s, .key = %s, .length = %zu, .spelling = \"%s\"},\n",
+            keyword_hash(kw, head_multiplier, tail_multiplier, bits),
+            (unsigned long long)kw->head,
+            (unsigned long long)kw->tail,
+            kw->id,
+            kw->flags,
+            kw->length,
+            kw->spelling
+        );
+    }
+
+    fprintf(out, "};\n\n");
+
+    // The same slots again as an X-macro, so tables indexed by slot can be built at compile time too.
+    fprintf(out, "#define LY_KEYWORD_SLOTS(X) \\\n");
+    for (size_t i = 0; i < KEYWORD_COUNT; i++) {
+        const keyword* kw = &keywords[i];
+        if (kw->spelling == NULL) continue;
+        fprintf(out, "    X(%u, %s, %s) \\\n", keyword_hash(kw, head_multiplier, tail_multiplier, bits), kw->id, kw->flags);
+    }
+
+    fprintf(out, "\n");
+
+    if (0 != fclose(out)) {
+        fprintf(stderr, "%s: could not write '%s'\n", argv[0], argv[1]);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,122 @@
+/// Build-time generator for the Laye/C punctuator recognizer.
+/// Reads the CH_PUNCT entries of <laye/tokens.h> and writes maximal munch tables of them, which lib/laye/lex.c includes.
+/// Run by nob as part of the build; usage: gen_ly_punctuators <output-file>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct punctuator {
+    const char* id;
+    const char* spelling;
+    const char* flags;
+    size_t length;
+} punctuator;
+
+static punctuator punctuators[] = {
+#define CH_PUNCT(Id, Spelling, Flags) {#Id, Spelling, #Flags, 0},
+#include <laye/tokens.h>
+};
+
+#define PUNCTUATOR_COUNT (sizeof(punctuators) / sizeof(punctuators[0]))
+
+/// The recognizer compares the bytes of a punctuator as one little-endian word, so none may be longer than this.
+#define MAX_LENGTH 4
+
+/// Group by first byte, then longest first, so that the first candidate to match is the maximal munch.
+static int compare_punctuators(const void* a, const void* b) {
+    const punctuator* lhs = a;
+    const punctuator* rhs = b;
+
+    if (lhs->spelling[0] != rhs->spelling[0]) {
+        return (unsigned char)lhs->spelling[0] < (unsigned char)rhs->spelling[0] ? -1 : 1;
+    }
+
+    if (lhs->length != rhs->length) {
+        return lhs->length > rhs->length ? -1 : 1;
+    }
+
+    return strcmp(lhs->spelling, rhs->spelling);
+}
+
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s <output-file>\n", argv[0]);
+        return 1;
+    }
+
+    size_t max_length = 0;
+    for (size_t i = 0; i < PUNCTUATOR_COUNT; i++) {
+        punctuator* p = &punctuators[i];
+        p->length = strlen(p->spelling);
+
+        if (p->length == 0 || p->length > MAX_LENGTH || (unsigned char)p->spelling[0] >= 0x80) {
+            fprintf(stderr, "%s: punctuator %s must be 1 to %d ASCII bytes long\n", argv[0], p->id, MAX_LENGTH);
+            return 1;
+        }
+
+        if (p->length > max_length) max_length = p->length;
+
+        for (size_t j = 0; j < i; j++) {
+            if (0 == strcmp(p->spelling, punctuators[j].spelling)) {
+                fprintf(stderr, "%s: punctuators %s and %s are both spelled '%s'\n", argv[0], punctuators[j].id, p->id, p->spelling);
+                return 1;
+            }
+        }
+    }
+
+    qsort(punctuators, PUNCTUATOR_COUNT, sizeof(punctuator), compare_punctuators);
+
+    FILE* out = fopen(argv[1], "w");
+    if (out == NULL) {
+        fprintf(stderr, "%s: could not open '%s' for writing\n", argv[0], argv[1]);
+        return 1;
+    }
+
+    fprintf(out, "// Generated by src/gen_ly_punctuators.c from include/laye/tokens.h; do not edit.\n\n");
+    fprintf(out, "#define LY_PUNCTUATOR_MAX_LENGTH %zu\n\n", max_length);
+
+    fprintf(out, "static const ly_punctuator ly_punctuators[%zu] = {\n", PUNCTUATOR_COUNT);
+    for (size_t i = 0; i < PUNCTUATOR_COUNT; i++) {
+        const punctuator* p = &punctuators[i];
+
+        uint32_t bytes = 0;
+        for (size_t j = 0; j < p->length; j++) {
+            bytes |= (uint32_t)(unsigned char)p->spelling[j] << (j * 8);
+        }
+
+        uint32_t mask = p->length == 4 ? 0xFFFFFFFFu : ((uint32_t)1 << (p->length * 8)) - 1;
+        fprintf(
+            out,
+            "    {.bytes = 0x%08X, .mask = 0x%08X, .kind = LY_TK_%s, .key = %s, .length = %zu}, // %s\n",
+            bytes,
+            mask,
+            p->id,
+            p->flags,
+            p->length,
+            p->spelling
+        );
+    }
+    fprintf(out, "};\n\n");
+
+    fprintf(out, "static const ly_punctuator_candidates ly_punctuator_candidates_by_byte[128] = {\n");
+    for (size_t i = 0; i < PUNCTUATOR_COUNT;) {
+        size_t first = i;
+        unsigned char byte = (unsigned char)punctuators[i].spelling[0];
+        while (i < PUNCTUATOR_COUNT && (unsigned char)punctuators[i].spelling[0] == byte) {
+            i++;
+        }
+
+        fprintf(out, "    [0x%02X] = {.first = %zu, .count = %zu}, // %c\n", byte, first, i - first, byte);
+    }
+    fprintf(out, "};\n");
+
+    if (0 != fclose(out)) {
+        fprintf(stderr, "%s: could not write '%s'\n", argv[0], argv[1]);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,66 @@
+/// Allocation rate benchmark for arenas, which should stay flat however big an arena grows.
+/// Built by nob along with everything else; `./nob bench` runs it.
+/// Usage: arena_benchmark [max megabytes]
+/// nob builds everything with sanitizers and without optimizations, so compare numbers between runs of the same build rather than reading them as absolutes.
+
+#include <time.h>
+
+#include <kos/kos.h>
+
+/// The size of every allocation, about that of a small syntax node.
+#define BENCHMARK_OBJECT_SIZE 48
+
+/// The size the arenas grow to unless another is given on the command line.
+#define BENCHMARK_DEFAULT_MAX_MEGABYTES 4096
+
+static double benchmark_now(void) {
+    struct timespec now;
+    timespec_get(&now, TIME_UTC);
+    return k_cast(double) now.tv_sec + k_cast(double) now.tv_nsec / 1e9;
+}
+
+/// Fill @c arena with small allocations up to @c max_size bytes, reporting the rate at which they were made each time its size doubles.
+/// The allocations are never written to, so what is measured is the arena rather than the kernel faulting in fresh pages.
+static void benchmark_arena_growth(k_arena* arena, const char* name, isize_t max_size) {
+    fprintf(stderr, "%s, %d bytes each\n", name, BENCHMARK_OBJECT_SIZE);
+
+    isize_t size = 0;
+    for (isize_t target_size = 1 << 20; target_size <= max_size; target_size *= 2) {
+        isize_t allocation_count = 0;
+        double start = benchmark_now();
+        while (size < target_size) {
+            k_discard k_arena_alloc_uninit(arena, BENCHMARK_OBJECT_SIZE);
+            size += BENCHMARK_OBJECT_SIZE;
+            allocation_count++;
+        }
+
+        double seconds = benchmark_now() - start;
+        fprintf(stderr, "  up to %6td MiB %12.1f M/s\n", target_size >> 20, k_cast(double) allocation_count / seconds / 1e6);
+    }
+
+    k_arena_print_stats(arena, stderr);
+}
+
+int main(int argc, char** argv) {
+    isize_t max_megabytes = argc > 1 ? atoi(argv[1]) : BENCHMARK_DEFAULT_MAX_MEGABYTES;
+    if (max_megabytes < 1) max_megabytes = 1;
+    isize_t max_size = max_megabytes << 20;
+
+    k_arena heap_arena = {0};
+    k_arena_init(&heap_arena);
+    k_arena_set_tag(&heap_arena, "heap");
+    benchmark_arena_growth(&heap_arena, "heap blocks", max_size);
+    k_arena_deinit(&heap_arena);
+
+    // The last allocation can run a little past the maximum, so reserve a commit's worth more than that.
+    k_arena virtual_arena = {0};
+    if (k_arena_init_virtual(&virtual_arena, k_cast(size_t) max_size + (1 << 20), K_ARENA_FLAGS_NONE)) {
+        k_arena_set_tag(&virtual_arena, "virtual");
+        benchmark_arena_growth(&virtual_arena, "virtual reservation", max_size);
+        k_arena_deinit(&virtual_arena);
+    } else {
+        fprintf(stderr, "virtual reservation: not supported here\n");
+    }
+
+    return 0;
+}
@@ -0,0 +1,316 @@
+/// Unit tests for kos: arenas, dynamic arrays, interning and UTF-8 decoding.
+/// Built by nob along with everything else; `./nob test` runs it.
+
+#include <kos/kos.h>
+
+static int failure_count = 0;
+
+#define EXPECT(Cond)                                                            \
+    do {                                                                        \
+        if (!(Cond)) {                                                          \
+            fprintf(stderr, "%s:%d: expected %s\n", __FILE__, __LINE__, #Cond); \
+            failure_count++;                                                    \
+        }                                                                       \
+    } while (0)
+
+///===--------------------------------------===///
+/// Arenas.
+///===--------------------------------------===///
+
+static void test_arena_alignment_and_zero_size(k_arena* arena) {
+    char* byte = k_arena_alloc_aligned(arena, 1, 1);
+    EXPECT(byte != nullptr);
+
+    double* values = k_arena_alloc_n(arena, double, 3);
+    EXPECT(0 == k_cast(uintptr_t) values % alignof(double));
+
+    void* aligned = k_arena_alloc_aligned(arena, 8, 64);
+    EXPECT(0 == k_cast(uintptr_t) aligned % 64);
+
+    // Empty allocations still get a valid, aligned pointer.
+    int* empty = k_arena_alloc_n(arena, int, 0);
+    EXPECT(empty != nullptr);
+    EXPECT(0 == k_cast(uintptr_t) empty % alignof(int));
+
+    char* zeroed = k_arena_alloc(arena, 32);
+    bool all_zero = true;
+    for (int i = 0; i < 32; i++) {
+        all_zero = all_zero && zeroed[i] == 0;
+    }
+
+    EXPECT(all_zero);
+}
+
+static void test_arena_rewind(k_arena* arena) {
+    char* before = k_arena_alloc_uninit(arena, 100);
+    memset(before, 'a', 100);
+
+    k_arena_checkpoint checkpoint = k_arena_mark(arena);
+    isize_t bytes_in_use = k_arena_get_stats(arena).bytes_in_use;
+
+    char* first = k_arena_alloc_uninit(arena, 1000);
+    // Enough to need another block in a heap arena, so the rewind has to step back over it.
+    char* large = k_arena_alloc_uninit(arena, 16 * 1024 * 1024);
+    memset(large, 'b', 16 * 1024 * 1024);
+
+    k_arena_rewind(arena, checkpoint);
+    EXPECT(k_arena_get_stats(arena).bytes_in_use == bytes_in_use);
+
+    // Allocating the same again after a rewind hands out the same memory.
+    char* again = k_arena_alloc_uninit(arena, 1000);
+    EXPECT(again == first);
+
+    bool untouched = true;
+    for (int i = 0; i < 100; i++) {
+        untouched = untouched && before[i] == 'a';
+    }
+
+    EXPECT(untouched);
+
+    k_arena_trim(arena);
+    char* after_trim = k_arena_alloc_uninit(arena, 16);
+    EXPECT(after_trim != nullptr);
+}
+
+static void test_arena_try_extend(k_arena* arena) {
+    char* data = k_arena_alloc_uninit(arena, 64);
+    memset(data, 'x', 64);
+
+    EXPECT(k_arena_try_extend(arena, data, 64, 128));
+    memset(data + 64, 'y', 64);
+    EXPECT(data[0] == 'x' && data[127] == 'y');
+
+    // Only the most recent allocation can grow.
+    char* other = k_arena_alloc_uninit(arena, 16);
+    EXPECT(!k_arena_try_extend(arena, data, 128, 256));
+    EXPECT(k_arena_try_extend(arena, other, 16, 32));
+
+    // An empty allocation is the most recent one too.
+    char* empty = k_arena_alloc_aligned(arena, 0, 1);
+    EXPECT(k_arena_try_extend(arena, empty, 0, 8));
+}
+
+static void test_arenas(void) {
+    k_arena heap;
+    k_arena_init(&heap);
+    test_arena_alignment_and_zero_size(&heap);
+    test_arena_rewind(&heap);
+    test_arena_try_extend(&heap);
+
+    // Growing past the end of a heap block cannot be done in place.
+    char* tail = k_arena_alloc_uninit(&heap, 1024);
+    EXPECT(!k_arena_try_extend(&heap, tail, 1024, 64 * 1024 * 1024));
+    EXPECT(!k_arena_try_extend(&heap, tail, 1024, SIZE_MAX));
+    k_arena_deinit(&heap);
+
+    // Without virtual memory this is a heap arena, which the tests above cover just the same.
+    k_arena virtual;
+    bool is_virtual = k_arena_init_virtual(&virtual, k_cast(size_t) 1 << 30, K_ARENA_FLAGS_NONE);
+    test_arena_alignment_and_zero_size(&virtual);
+    test_arena_rewind(&virtual);
+    test_arena_try_extend(&virtual);
+
+    if (is_virtual) {
+        // Anywhere in the reservation is room to grow into.
+        char* tail = k_arena_alloc_uninit(&virtual, 1024);
+        EXPECT(k_arena_try_extend(&virtual, tail, 1024, 64 * 1024 * 1024));
+        tail[64 * 1024 * 1024 - 1] = 1;
+
+        // Past the end of the reservation is not, even for sizes which would wrap around the address space.
+        EXPECT(!k_arena_try_extend(&virtual, tail, 64 * 1024 * 1024, k_cast(size_t) 2 << 30));
+        EXPECT(!k_arena_try_extend(&virtual, tail, 64 * 1024 * 1024, SIZE_MAX));
+    }
+
+    k_arena_deinit(&virtual);
+}
+
+///===--------------------------------------===///
+/// Dynamic arrays.
+///===--------------------------------------===///
+
+typedef struct int_array {
+    K_DA_DECLARE_INLINE(int);
+} int_array;
+
+static void test_da_growth_in_place(void) {
+    k_arena arena;
+    k_arena_init(&arena);
+
+    // While the array is the arena's most recent allocation, every doubling extends it where it is.
+    int_array values = {.arena = &arena};
+    k_da_push(&values, 0);
+    int* first_data = values.data;
+    for (int i = 1; i < 100000; i++) {
+        k_da_push(&values, i);
+    }
+
+    EXPECT(values.data == first_data);
+    EXPECT(k_arena_get_stats(&arena).allocation_count == 1);
+
+    bool in_order = values.count == 100000;
+    for (isize_t i = 0; i < values.count && in_order; i++) {
+        in_order = values.data[i] == i;
+    }
+
+    EXPECT(in_order);
+
+    // Once something else is allocated after it, growing has to copy.
+    k_arena_alloc_uninit(&arena, 16);
+    isize_t capacity = values.capacity;
+    for (isize_t i = values.count; i <= capacity; i++) {
+        k_da_push(&values, k_cast(int) i);
+    }
+
+    EXPECT(values.data != first_data);
+    EXPECT(values.data[0] == 0 && values.data[capacity] == capacity);
+
+    int_array exact = {.arena = &arena};
+    k_da_reserve_exact(&exact, 10);
+    EXPECT(exact.capacity == 10);
+
+    k_da_insert(&exact, 0, 2);
+    k_da_insert(&exact, 0, 1);
+    k_da_insert(&exact, 2, 3);
+    EXPECT(exact.count == 3 && exact.data[0] == 1 && exact.data[1] == 2 && exact.data[2] == 3);
+    EXPECT(k_da_pop(&exact) == 3 && exact.count == 2);
+
+    k_arena_deinit(&arena);
+
+    // Heap-backed arrays grow with realloc and can be freed and shrunk.
+    int_array heap = {0};
+    for (int i = 0; i < 1000; i++) {
+        k_da_push(&heap, i);
+    }
+
+    k_da_truncate(&heap, 10);
+    k_da_shrink_to_fit(&heap);
+    EXPECT(heap.capacity == 10 && heap.data[9] == 9);
+    k_da_free(&heap);
+    EXPECT(heap.data == nullptr && heap.count == 0);
+}
+
+///===--------------------------------------===///
+/// Interning.
+///===--------------------------------------===///
+
+static void test_intern(void) {
+    k_arena arena;
+    k_arena_init(&arena);
+
+    k_intern_table table;
+    k_intern_table_init(&table, &arena);
+
+    EXPECT(K_INTERN_ID_NONE == k_intern(&table, K_SV_CONST("")));
+    EXPECT(0 == k_intern_get(&table, K_INTERN_ID_NONE).count);
+    EXPECT(K_INTERN_ID_NONE == k_intern_find(&table, K_SV_CONST("never")));
+
+    k_intern_id foo = k_intern(&table, K_SV_CONST("foo"));
+    k_intern_id bar = k_intern(&table, K_SV_CONST("bar"));
+    EXPECT(foo != K_INTERN_ID_NONE && bar != K_INTERN_ID_NONE && foo != bar);
+
+    // A copy of the spelling, not the same pointer, still gets the same handle.
+    char spelling[] = "foo";
+    EXPECT(foo == k_intern(&table, k_sv(spelling, 3)));
+    EXPECT(foo == k_intern_find(&table, k_sv(spelling, 3)));
+
+    k_string_view text = k_intern_get(&table, foo);
+    EXPECT(text.count == 3 && 0 == memcmp(text.data, "foo", 3) && text.data[3] == 0);
+    EXPECT(text.data != spelling);
+
+    // Enough strings to grow the table several times over, each of which must still round-trip.
+    enum { STRING_COUNT = 20000 };
+    k_intern_id* ids = calloc(STRING_COUNT, sizeof(k_intern_id));
+    assert(ids != nullptr && "Buy more RAM lol");
+
+    char buffer[32];
+    for (int i = 0; i < STRING_COUNT; i++) {
+        int length = snprintf(buffer, sizeof(buffer), "name_%d", i);
+        ids[i] = k_intern(&table, k_sv(buffer, length));
+    }
+
+    bool all_round_trip = true;
+    for (int i = 0; i < STRING_COUNT; i++) {
+        int length = snprintf(buffer, sizeof(buffer), "name_%d", i);
+        k_string_view interned = k_intern_get(&table, ids[i]);
+        all_round_trip = all_round_trip && interned.count == length && 0 == memcmp(interned.data, buffer, k_cast(size_t) length);
+        all_round_trip = all_round_trip && ids[i] == k_intern_find(&table, k_sv(buffer, length));
+    }
+
+    EXPECT(all_round_trip);
+    EXPECT(foo == k_intern_find(&table, K_SV_CONST("foo")));
+
+    free(ids);
+    k_arena_deinit(&arena);
+}
+
+///===--------------------------------------===///
+/// UTF-8.
+///===--------------------------------------===///
+
+/// Decodes 'text' and checks the result is 'expected_codepoint', 'expected_stride' bytes long, or fails for 'expected_result'.
+static bool utf8_decodes_to(const char* text, k_unicode_decode_result expected_result, int32_t expected_codepoint, isize_t expected_stride) {
+    int32_t codepoint = -1;
+    isize_t stride = -1;
+    k_unicode_decode_result result = k_utf8_decode(text, k_cast(isize_t) strlen(text), 0, &codepoint, &stride);
+    return result == expected_result && stride == expected_stride && (result != K_UNICODE_SUCCESS || codepoint == expected_codepoint);
+}
+
+static void test_utf8(void) {
+    EXPECT(utf8_decodes_to("A", K_UNICODE_SUCCESS, 'A', 1));
+    EXPECT(utf8_decodes_to("\xC3\xA9", K_UNICODE_SUCCESS, 0xE9, 2));
+    EXPECT(utf8_decodes_to("\xE2\x82\xAC", K_UNICODE_SUCCESS, 0x20AC, 3));
+    EXPECT(utf8_decodes_to("\xF0\x9F\x98\x80", K_UNICODE_SUCCESS, 0x1F600, 4));
+    EXPECT(utf8_decodes_to("\xF4\x8F\xBF\xBF", K_UNICODE_SUCCESS, 0x10FFFF, 4));
+
+    // Every way to be ill-formed is rejected with its own reason, and a stride of the maximal subpart of a valid sequence, which here is just the lead byte.
+    EXPECT(utf8_decodes_to("\x80", K_UNICODE_INVALID_START_BYTE, 0, 1));
+    EXPECT(utf8_decodes_to("\xC0\x80", K_UNICODE_OVERLONG_ENCODING, 0, 1));
+    EXPECT(utf8_decodes_to("\xE0\x80\x80", K_UNICODE_OVERLONG_ENCODING, 0, 1));
+    EXPECT(utf8_decodes_to("\xED\xA0\x80", K_UNICODE_INVALID_CODEPOINT, 0, 1));
+    EXPECT(utf8_decodes_to("\xF4\x90\x80\x80", K_UNICODE_INVALID_CODEPOINT, 0, 1));
+    EXPECT(utf8_decodes_to("\xC3(", K_UNICODE_INVALID_CONTINUE_BYTE, 0, 1));
+
+    // A sequence cut off by the end of the data is not read past it.
+    int32_t codepoint = 0;
+    isize_t stride = 0;
+    EXPECT(K_UNICODE_SUCCESS != k_utf8_decode("\xE2\x82", 2, 0, &codepoint, &stride) && stride >= 1 && stride <= 2);
+
+    // Batch decoding agrees with decoding one at a time, and substitutes U+FFFD for what is ill-formed.
+    const char* mixed = "a\xC3\xA9\xE4\xB8\xAD\xFFz\xF0\x9F\x98\x80";
+    isize_t mixed_count = k_cast(isize_t) strlen(mixed);
+    int32_t codepoints[16];
+    isize_t offsets[16];
+    isize_t offset = 0;
+    isize_t decoded_count = k_utf8_decode_many(mixed, mixed_count, &offset, codepoints, offsets, 16);
+    EXPECT(decoded_count == 6 && offset == mixed_count);
+    EXPECT(codepoints[0] == 'a' && codepoints[1] == 0xE9 && codepoints[2] == 0x4E2D);
+    EXPECT(codepoints[3] == K_UNICODE_REPLACEMENT_CHARACTER && codepoints[4] == 'z' && codepoints[5] == 0x1F600);
+    EXPECT(offsets[0] == 0 && offsets[1] == 1 && offsets[2] == 3 && offsets[3] == 6 && offsets[4] == 7 && offsets[5] == 8);
+
+    // Decoding stops after the requested number of codepoints, ready to carry on.
+    offset = 0;
+    EXPECT(2 == k_utf8_decode_many(mixed, mixed_count, &offset, codepoints, nullptr, 2) && offset == 3);
+
+    // Validation finds exactly the ill-formed sequences, and skips ASCII runs to get to them.
+    k_unicode_decode_result reason;
+    isize_t invalid_length = 0;
+    EXPECT(6 == k_utf8_validate(mixed, mixed_count, 0, &reason, &invalid_length) && invalid_length == 1);
+    EXPECT(mixed_count == k_utf8_validate(mixed, mixed_count, 7, &reason, &invalid_length));
+    EXPECT(5 == k_ascii_prefix_length("hello\x80 world, and then some more to cover a whole vector", 60));
+    EXPECT(40 == k_ascii_prefix_length("0123456789012345678901234567890123456789", 40));
+}
+
+int main(void) {
+    test_arenas();
+    test_da_growth_in_place();
+    test_intern();
+    test_utf8();
+
+    if (failure_count != 0) {
+        fprintf(stderr, "kos_test: %d failed\n", failure_count);
+        return 1;
+    }
+
+    fprintf(stderr, "kos_test: passed\n");
+    return 0;
+}
@@ -0,0 +1,670 @@
+/// Unit tests for the Laye and C lexer: keywords and punctuators in both modes, keyword lookup in every dialect, source normalization and locations, and batch and parallel lexing.
+/// Built by nob along with everything else; `./nob test` runs it.
+
+#include <choir/core.h>
+#include <laye/core.h>
+
+static int failure_count = 0;
+
+#define EXPECT(Cond)                                                            \
+    do {                                                                        \
+        if (!(Cond)) {                                                          \
+            fprintf(stderr, "%s:%d: expected %s\n", __FILE__, __LINE__, #Cond); \
+            failure_count++;                                                    \
+        }                                                                       \
+    } while (0)
+
+typedef struct test_context {
+    k_arena string_arena;
+    k_arena node_arena;
+    k_arena diag_arena;
+    k_diag diag;
+    ch_context context;
+    int error_count;
+} test_context;
+
+static void test_diag_callback(void* userdata, k_diag_data_group group) {
+    test_context* test = userdata;
+    for (isize_t i = 0; i < group.count; i++) {
+        if (group.data[i].level >= K_DIAG_ERROR) {
+            test->error_count++;
+        }
+    }
+}
+
+static void test_context_init(test_context* test) {
+    k_arena_init(&test->string_arena);
+    k_arena_init(&test->node_arena);
+    k_arena_init(&test->diag_arena);
+    k_diag_init(&test->diag, &test->diag_arena, test_diag_callback, test);
+    ch_context_init(&test->context, &test->diag, &test->string_arena, &test->node_arena);
+}
+
+static void test_context_deinit(test_context* test) {
+    k_diag_deinit(&test->diag);
+    k_arena_deinit(&test->diag_arena);
+    k_arena_deinit(&test->node_arena);
+    k_arena_deinit(&test->string_arena);
+}
+
+/// Lex @c text in @c mode and check the token kinds against @c expected, which ends with @c LY_TK_END_OF_FILE.
+/// C is lexed as the dialects in @c c_dialect, or the default ones if it is @c LY_TKKEY_NOT_KW.
+/// Mismatches are reported against the line of the caller.
+static void expect_kinds_at(int line, ly_lexer_mode mode, ly_token_key c_dialect, const char* text, const ly_token_kind* expected) {
+    test_context test = {0};
+    test_context_init(&test);
+    if (c_dialect != LY_TKKEY_NOT_KW) {
+        ly_context_set_c_dialect(&test.context, c_dialect);
+    }
+
+    ch_source source = {
+        .name = K_SV_CONST("test"),
+        .text = k_sv_from_cstr(text),
+    };
+
+    ly_tokens tokens = {0};
+    ly_tokens_init(&tokens, &test.context);
+    ly_lexer_lex_all(&source, mode, &tokens);
+
+    isize_t expected_count = 0;
+    while (expected[expected_count] != LY_TK_END_OF_FILE) {
+        expected_count++;
+    }
+    expected_count++;
+
+    if (tokens.count != expected_count) {
+        fprintf(stderr, "%s:%d: expected %td tokens for \"%s\", got %td\n", __FILE__, line, expected_count, text, tokens.count);
+        failure_count++;
+    } else {
+        for (isize_t i = 0; i < tokens.count; i++) {
+            ly_token_kind kind = ly_tokens_kind(&tokens, i);
+            if (kind != expected[i]) {
+                fprintf(stderr, "%s:%d: expected %s at token %td of \"%s\", got %s\n", __FILE__, line, ly_token_kind_get_name(expected[i]), i, text, ly_token_kind_get_name(kind));
+                failure_count++;
+                break;
+            }
+        }
+    }
+
+    if (test.error_count != 0) {
+        fprintf(stderr, "%s:%d: unexpected errors lexing \"%s\"\n", __FILE__, line, text);
+        failure_count++;
+    }
+
+    ly_tokens_deinit(&tokens);
+    test_context_deinit(&test);
+}
+
+/// Check that two token buffers hold the same tokens, with the same spellings.
+/// The buffers may be in different contexts, so long as the same text was interned into both in the same order.
+static void expect_same_tokens_at(int line, const ly_tokens* expected, const ly_tokens* actual) {
+    if (expected->count != actual->count) {
+        fprintf(stderr, "%s:%d: expected %td tokens, got %td\n", __FILE__, line, expected->count, actual->count);
+        failure_count++;
+        return;
+    }
+
+    for (isize_t i = 0; i < expected->count; i++) {
+        ly_token expected_token = ly_tokens_get(expected, i);
+        ly_token actual_token = ly_tokens_get(actual, i);
+
+        bool same = expected->kinds[i] == actual->kinds[i] && expected->flags[i] == actual->flags[i] && expected->begins[i] == actual->begins[i] && expected->ends[i] == actual->ends[i] && expected->data[i] == actual->data[i];
+        same = same && expected_token.text_value.count == actual_token.text_value.count;
+        same = same && (expected_token.text_value.count == 0 || 0 == memcmp(expected_token.text_value.data, actual_token.text_value.data, k_cast(size_t) expected_token.text_value.count));
+        if (!same) {
+            fprintf(stderr, "%s:%d: tokens differ at %td: expected %s, got %s\n", __FILE__, line, i, ly_token_kind_get_name(expected_token.kind), ly_token_kind_get_name(actual_token.kind));
+            failure_count++;
+            return;
+        }
+    }
+}
+
+#define EXPECT_SAME_TOKENS(Expected, Actual) expect_same_tokens_at(__LINE__, Expected, Actual)
+
+#define EXPECT_KINDS(Mode, Text, ...) expect_kinds_at(__LINE__, Mode, LY_TKKEY_NOT_KW, Text, (const ly_token_kind[]){__VA_ARGS__, LY_TK_END_OF_FILE})
+#define EXPECT_C_DIALECT_KINDS(Keys, Text, ...) expect_kinds_at(__LINE__, LY_LEXMODE_C, Keys, Text, (const ly_token_kind[]){__VA_ARGS__, LY_TK_END_OF_FILE})
+
+///===--------------------------------------===///
+/// Punctuators.
+///===--------------------------------------===///
+
+static void test_punctuators(void) {
+    // The longest punctuator always wins, so runs of operators split greedily from the left.
+    EXPECT_KINDS(LY_LEXMODE_C, "x+++++y", LY_TK_PP_NOT_KEYWORD, LY_TK_PLUS_PLUS, LY_TK_PLUS_PLUS, LY_TK_PLUS, LY_TK_PP_NOT_KEYWORD);
+    EXPECT_KINDS(LY_LEXMODE_C, "a->b-->c", LY_TK_PP_NOT_KEYWORD, LY_TK_MINUS_GREATER, LY_TK_PP_NOT_KEYWORD, LY_TK_MINUS_MINUS, LY_TK_GREATER, LY_TK_PP_NOT_KEYWORD);
+    EXPECT_KINDS(LY_LEXMODE_C, "a<<=b>>=c", LY_TK_PP_NOT_KEYWORD, LY_TK_LESS_LESS_EQUAL, LY_TK_PP_NOT_KEYWORD, LY_TK_GREATER_GREATER_EQUAL, LY_TK_PP_NOT_KEYWORD);
+    EXPECT_KINDS(LY_LEXMODE_C, "x ## y :: z", LY_TK_PP_NOT_KEYWORD, LY_TK_HASH_HASH, LY_TK_PP_NOT_KEYWORD, LY_TK_COLON_COLON, LY_TK_PP_NOT_KEYWORD);
+
+    // Three dots are an ellipsis in C, but two are not a token there.
+    EXPECT_KINDS(LY_LEXMODE_C, "f(...) ..", LY_TK_PP_NOT_KEYWORD, LY_TK_OPEN_PAREN, LY_TK_DOT_DOT_DOT, LY_TK_CLOSE_PAREN, LY_TK_DOT, LY_TK_DOT);
+
+    // Laye-only punctuators fall apart into their C pieces in C mode.
+    EXPECT_KINDS(LY_LEXMODE_C, "a<=>b=>c", LY_TK_PP_NOT_KEYWORD, LY_TK_LESS_EQUAL, LY_TK_GREATER, LY_TK_PP_NOT_KEYWORD, LY_TK_EQUAL, LY_TK_GREATER, LY_TK_PP_NOT_KEYWORD);
+
+    EXPECT_KINDS(LY_LEXMODE_LAYE, "a<=>b=>c", LY_TK_PP_NOT_KEYWORD, LY_TK_LESS_EQUAL_GREATER, LY_TK_PP_NOT_KEYWORD, LY_TK_EQUAL_GREATER, LY_TK_PP_NOT_KEYWORD);
+    EXPECT_KINDS(LY_LEXMODE_LAYE, "a..=b..c", LY_TK_PP_NOT_KEYWORD, LY_TK_DOT_DOT_EQUAL, LY_TK_PP_NOT_KEYWORD, LY_TK_DOT_DOT, LY_TK_PP_NOT_KEYWORD);
+    EXPECT_KINDS(LY_LEXMODE_LAYE, "a ?\?= b ?? c", LY_TK_PP_NOT_KEYWORD, LY_TK_QUESTION_QUESTION_EQUAL, LY_TK_PP_NOT_KEYWORD, LY_TK_QUESTION_QUESTION, LY_TK_PP_NOT_KEYWORD);
+    EXPECT_KINDS(LY_LEXMODE_LAYE, "x #[y] a::b", LY_TK_PP_NOT_KEYWORD, LY_TK_HASH_SQUARE, LY_TK_PP_NOT_KEYWORD, LY_TK_CLOSE_SQUARE, LY_TK_PP_NOT_KEYWORD, LY_TK_COLON_COLON, LY_TK_PP_NOT_KEYWORD);
+    EXPECT_KINDS(LY_LEXMODE_LAYE, "a<<=b->c", LY_TK_PP_NOT_KEYWORD, LY_TK_LESS_LESS_EQUAL, LY_TK_PP_NOT_KEYWORD, LY_TK_MINUS_GREATER, LY_TK_PP_NOT_KEYWORD);
+}
+
+///===--------------------------------------===///
+/// Keywords.
+///===--------------------------------------===///
+
+static void test_keywords(void) {
+    // Identifiers are read whole before being looked up, so keyword prefixes and extensions stay identifiers.
+    EXPECT_KINDS(LY_LEXMODE_C, "int integer in returns return", LY_TK_KW_INT, LY_TK_PP_NOT_KEYWORD, LY_TK_PP_NOT_KEYWORD, LY_TK_PP_NOT_KEYWORD, LY_TK_KW_RETURN);
+    EXPECT_KINDS(LY_LEXMODE_LAYE, "int integer in returns return", LY_TK_KW_INT, LY_TK_PP_NOT_KEYWORD, LY_TK_PP_NOT_KEYWORD, LY_TK_PP_NOT_KEYWORD, LY_TK_KW_RETURN);
+
+    // Each dialect only sees its own keywords.
+    EXPECT_KINDS(LY_LEXMODE_C, "_Bool bool typeof var xyzzy", LY_TK_KW__BOOL, LY_TK_KW_BOOL, LY_TK_KW_TYPEOF, LY_TK_PP_NOT_KEYWORD, LY_TK_PP_NOT_KEYWORD);
+    EXPECT_KINDS(LY_LEXMODE_LAYE, "_Bool bool typeof var xyzzy", LY_TK_PP_NOT_KEYWORD, LY_TK_KW_BOOL, LY_TK_KW_TYPEOF, LY_TK_KW_VAR, LY_TK_KW_XYZZY);
+}
+
+/// A keyword as declared in tokens.h, for checking the generated lookup against a plain search.
+typedef struct test_keyword {
+    ly_token_kind kind;
+    const char* spelling;
+    ly_token_key keys;
+} test_keyword;
+
+static const test_keyword test_keyword_list[] = {
+#define CH_KEYWORD(id, spelling, flags) {LY_TK_KW_##id, spelling, flags},
+#include <laye/tokens.h>
+};
+
+/// A dialect set to look keywords up in, along with every flag it implies spelled out by hand.
+typedef struct test_keyword_keys {
+    ly_token_key keys;
+    ly_token_key implied_keys;
+} test_keyword_keys;
+
+static const test_keyword_keys test_keyword_key_sets[] = {
+    {LY_TKKEY_C, LY_TKKEY_C},
+    {LY_TKKEY_C99, LY_TKKEY_C99 | LY_TKKEY_C},
+    {LY_TKKEY_C23, LY_TKKEY_C23 | LY_TKKEY_C99 | LY_TKKEY_C | LY_TKKEY_BOOL},
+    {LY_TKKEY_C | LY_TKKEY_BOOL, LY_TKKEY_C | LY_TKKEY_BOOL},
+    {LY_TKKEY_C99 | LY_TKKEY_GNU, LY_TKKEY_C99 | LY_TKKEY_C | LY_TKKEY_GNU},
+    {LY_TKKEY_GNU, LY_TKKEY_GNU},
+    {LY_TKKEY_MS, LY_TKKEY_MS},
+    {LY_TKKEY_MS_COMPAT, LY_TKKEY_MS_COMPAT | LY_TKKEY_MS},
+    {LY_TKKEY_CLANG | LY_TKKEY_CHOIR, LY_TKKEY_CLANG | LY_TKKEY_CHOIR},
+    {LY_TKKEY_LAYE, LY_TKKEY_LAYE},
+    {LY_TKKEY_ALL, LY_TKKEY_ALL},
+};
+
+#define TEST_KEYWORD_KEY_SET_COUNT (k_cast(isize_t)(sizeof(test_keyword_key_sets) / sizeof(test_keyword_key_sets[0])))
+
+/// Find @c spelling by searching every keyword in turn, for the keywords of exactly the dialects in @c keys.
+static ly_token_kind test_keyword_search(k_string_view spelling, ly_token_key keys) {
+    for (size_t i = 0; i < sizeof(test_keyword_list) / sizeof(test_keyword_list[0]); i++) {
+        const test_keyword* keyword = &test_keyword_list[i];
+        if (keyword->spelling == nullptr || 0 == (keyword->keys & keys)) continue;
+        if (k_cast(isize_t) strlen(keyword->spelling) != spelling.count) continue;
+        if (0 == memcmp(keyword->spelling, spelling.data, k_cast(size_t) spelling.count)) return keyword->kind;
+    }
+
+    return LY_TK_PP_NOT_KEYWORD;
+}
+
+/// Check that the perfect hash lookup and a table built for every dialect set agree with searching for @c spelling.
+static void expect_keyword_lookups_at(int line, const ly_keyword_table** tables, const char* data, isize_t count) {
+    k_string_view spelling = k_sv(data, count);
+    for (isize_t i = 0; i < TEST_KEYWORD_KEY_SET_COUNT; i++) {
+        ly_token_kind expected = test_keyword_search(spelling, test_keyword_key_sets[i].implied_keys);
+        ly_token_kind from_keyword = ly_token_kind_from_keyword(spelling, test_keyword_key_sets[i].keys);
+        ly_token_kind from_table = ly_keyword_table_lookup(tables[i], spelling);
+        if (from_keyword != expected || from_table != expected) {
+            fprintf(stderr, "%s:%d: expected %s for \"%.*s\" with keys 0x%X, got %s and %s from a table\n", __FILE__, line, ly_token_kind_get_name(expected), (int) count, data, test_keyword_key_sets[i].keys, ly_token_kind_get_name(from_keyword), ly_token_kind_get_name(from_table));
+            failure_count++;
+        }
+    }
+}
+
+#define EXPECT_KEYWORD_LOOKUPS(Tables, Data, Count) expect_keyword_lookups_at(__LINE__, Tables, Data, Count)
+
+static void test_keyword_lookup(void) {
+    k_arena arena = {0};
+    k_arena_init(&arena);
+
+    const ly_keyword_table* tables[TEST_KEYWORD_KEY_SET_COUNT];
+    for (isize_t i = 0; i < TEST_KEYWORD_KEY_SET_COUNT; i++) {
+        tables[i] = ly_keyword_table_create(&arena, test_keyword_key_sets[i].keys);
+    }
+
+    // The generator's maximum length is private to the lexer, but it is only ever the length of the longest keyword.
+    isize_t max_length = 0;
+    for (size_t i = 0; i < sizeof(test_keyword_list) / sizeof(test_keyword_list[0]); i++) {
+        if (test_keyword_list[i].spelling == nullptr) continue;
+        isize_t count = k_cast(isize_t) strlen(test_keyword_list[i].spelling);
+        if (count > max_length) max_length = count;
+    }
+
+    // Every keyword, and near misses of it: a byte off, a byte short, a byte long, and each byte replaced or with its case flipped.
+    // Replacing a byte in the middle of a keyword over 16 bytes leaves both its head and tail words the same.
+    char* probe = k_arena_alloc(&arena, k_cast(size_t) max_length + 2);
+    for (size_t i = 0; i < sizeof(test_keyword_list) / sizeof(test_keyword_list[0]); i++) {
+        const char* spelling = test_keyword_list[i].spelling;
+        if (spelling == nullptr) continue;
+
+        isize_t count = k_cast(isize_t) strlen(spelling);
+        EXPECT(test_keyword_list[i].kind == ly_token_kind_from_keyword(k_sv(spelling, count), test_keyword_list[i].keys));
+
+        EXPECT_KEYWORD_LOOKUPS(tables, spelling, count);
+        EXPECT_KEYWORD_LOOKUPS(tables, spelling, count - 1);
+        EXPECT_KEYWORD_LOOKUPS(tables, spelling + 1, count - 1);
+
+        memcpy(probe, spelling, k_cast(size_t) count);
+        probe[count] = 'x';
+        EXPECT_KEYWORD_LOOKUPS(tables, probe, count + 1);
+
+        for (isize_t j = 0; j < count; j++) {
+            memcpy(probe, spelling, k_cast(size_t) count);
+            probe[j] = '$';
+            EXPECT_KEYWORD_LOOKUPS(tables, probe, count);
+
+            probe[j] = spelling[j] ^ 0x20;
+            EXPECT_KEYWORD_LOOKUPS(tables, probe, count);
+        }
+    }
+
+    // Misses of every length a keyword can have, and either side of it.
+    EXPECT(max_length > 16);
+    for (isize_t count = 0; count <= max_length + 1; count++) {
+        memset(probe, 'q', k_cast(size_t) count);
+        EXPECT_KEYWORD_LOOKUPS(tables, probe, count);
+        memset(probe, '_', k_cast(size_t) count);
+        EXPECT_KEYWORD_LOOKUPS(tables, probe, count);
+    }
+
+    EXPECT(LY_TK_PP_NOT_KEYWORD == ly_token_kind_from_keyword(K_SV_CONST("__builtin_xyz_long_double"), LY_TKKEY_ALL));
+    EXPECT(LY_TK_PP_NOT_KEYWORD == ly_token_kind_from_keyword(K_SV_CONST("__builtin_ffi_long_lo_double"), LY_TKKEY_ALL));
+
+    // The dialect differences the lexer depends on, spelled out.
+    EXPECT(LY_TK_KW__BOOL == ly_token_kind_from_keyword(K_SV_CONST("_Bool"), LY_TKKEY_C));
+    EXPECT(LY_TK_PP_NOT_KEYWORD == ly_token_kind_from_keyword(K_SV_CONST("bool"), LY_TKKEY_C | LY_TKKEY_C99));
+    EXPECT(LY_TK_KW_BOOL == ly_token_kind_from_keyword(K_SV_CONST("bool"), LY_TKKEY_C | LY_TKKEY_BOOL));
+    EXPECT(LY_TK_KW_BOOL == ly_token_kind_from_keyword(K_SV_CONST("bool"), LY_TKKEY_C23));
+    EXPECT(LY_TK_KW__BOOL == ly_token_kind_from_keyword(K_SV_CONST("_Bool"), LY_TKKEY_C23));
+    EXPECT(LY_TK_PP_NOT_KEYWORD == ly_token_kind_from_keyword(K_SV_CONST("restrict"), LY_TKKEY_C));
+    EXPECT(LY_TK_KW_RESTRICT == ly_token_kind_from_keyword(K_SV_CONST("restrict"), LY_TKKEY_C99));
+    EXPECT(LY_TK_KW_INLINE == ly_token_kind_from_keyword(K_SV_CONST("inline"), LY_TKKEY_C | LY_TKKEY_GNU));
+    EXPECT(LY_TK_PP_NOT_KEYWORD == ly_token_kind_from_keyword(K_SV_CONST("typeof"), LY_TKKEY_C | LY_TKKEY_C99));
+    EXPECT(LY_TK_KW_TYPEOF == ly_token_kind_from_keyword(K_SV_CONST("typeof"), LY_TKKEY_C | LY_TKKEY_C99 | LY_TKKEY_GNU));
+    EXPECT(LY_TK_KW___ATTRIBUTE__ == ly_token_kind_from_keyword(K_SV_CONST("__attribute__"), LY_TKKEY_GNU));
+    EXPECT(LY_TK_PP_NOT_KEYWORD == ly_token_kind_from_keyword(K_SV_CONST("__attribute__"), LY_TKKEY_LAYE));
+    EXPECT(0 != (ly_token_key_normalize(LY_TKKEY_MS_COMPAT) & LY_TKKEY_MS));
+
+    // The built-in tables are the same as building them.
+    EXPECT(ly_keyword_table_get_builtin(LY_TKKEY_C) == nullptr);
+    const ly_keyword_table* c23_table = ly_keyword_table_get_builtin(LY_TKKEY_C23);
+    const ly_keyword_table* laye_table = ly_keyword_table_get_builtin(LY_TKKEY_LAYE);
+    EXPECT(c23_table != nullptr && laye_table != nullptr);
+    for (size_t i = 0; i < sizeof(test_keyword_list) / sizeof(test_keyword_list[0]); i++) {
+        if (test_keyword_list[i].spelling == nullptr) continue;
+        k_string_view spelling = k_sv_from_cstr(test_keyword_list[i].spelling);
+        EXPECT(ly_keyword_table_lookup(c23_table, spelling) == ly_token_kind_from_keyword(spelling, LY_TKKEY_C23));
+        EXPECT(ly_keyword_table_lookup(laye_table, spelling) == ly_token_kind_from_keyword(spelling, LY_TKKEY_LAYE));
+    }
+
+    k_arena_deinit(&arena);
+}
+
+/// Read the next token with @c lexer and check its kind, reporting a mismatch against the line of the caller.
+static void expect_next_kind_at(int line, ly_lexer* lexer, ly_token_kind expected) {
+    ly_token token = ly_lexer_read_pp_token(lexer);
+    if (token.kind != expected) {
+        fprintf(stderr, "%s:%d: expected %s, got %s\n", __FILE__, line, ly_token_kind_get_name(expected), ly_token_kind_get_name(token.kind));
+        failure_count++;
+    }
+}
+
+#define EXPECT_NEXT_KIND(Lexer, Kind) expect_next_kind_at(__LINE__, Lexer, Kind)
+
+static void test_keyword_table_across_modes(void) {
+    test_context test = {0};
+    test_context_init(&test);
+
+    ch_source source = {
+        .name = K_SV_CONST("modes"),
+        .text = K_SV_CONST("bool inline _Bool bool var bool inline"),
+    };
+
+    ly_lexer lexer = {0};
+    ly_lexer_init(&lexer, &test.context, &source, LY_LEXMODE_C);
+
+    // C89 has neither bool nor inline, which the default C23 table would both find.
+    ly_lexer_set_keyword_table(&lexer, ly_keyword_table_create(&test.string_arena, LY_TKKEY_C));
+    EXPECT_NEXT_KIND(&lexer, LY_TK_PP_NOT_KEYWORD);
+
+    // Directives and rejected branches are C modes too, so they keep the table.
+    ly_lexer_push_mode(&lexer, LY_LEXMODE_C | LY_LEXMODE_DIRECTIVE);
+    EXPECT_NEXT_KIND(&lexer, LY_TK_PP_NOT_KEYWORD);
+    ly_lexer_push_mode(&lexer, LY_LEXMODE_C | LY_LEXMODE_REJECTED_BRANCH);
+    EXPECT_NEXT_KIND(&lexer, LY_TK_KW__BOOL);
+    ly_lexer_pop_mode(&lexer);
+    ly_lexer_pop_mode(&lexer);
+    EXPECT_NEXT_KIND(&lexer, LY_TK_PP_NOT_KEYWORD);
+
+    // Switching language swaps to that language's table, and back again.
+    ly_lexer_push_mode(&lexer, LY_LEXMODE_LAYE);
+    EXPECT_NEXT_KIND(&lexer, LY_TK_KW_VAR);
+    EXPECT_NEXT_KIND(&lexer, LY_TK_KW_BOOL);
+    ly_lexer_pop_mode(&lexer);
+    EXPECT_NEXT_KIND(&lexer, LY_TK_PP_NOT_KEYWORD);
+    EXPECT_NEXT_KIND(&lexer, LY_TK_END_OF_FILE);
+
+    EXPECT(test.error_count == 0);
+    test_context_deinit(&test);
+}
+
+static void test_c_dialects(void) {
+    // C23 unless the context says otherwise; C17 has _Bool but no bool, and typeof only with GNU extensions.
+    EXPECT_KINDS(LY_LEXMODE_C, "bool _Bool typeof nullptr", LY_TK_KW_BOOL, LY_TK_KW__BOOL, LY_TK_KW_TYPEOF, LY_TK_KW_NULLPTR);
+    EXPECT_C_DIALECT_KINDS(LY_TKKEY_C23, "bool _Bool typeof nullptr", LY_TK_KW_BOOL, LY_TK_KW__BOOL, LY_TK_KW_TYPEOF, LY_TK_KW_NULLPTR);
+    EXPECT_C_DIALECT_KINDS(LY_TKKEY_C99, "bool _Bool typeof nullptr", LY_TK_PP_NOT_KEYWORD, LY_TK_KW__BOOL, LY_TK_PP_NOT_KEYWORD, LY_TK_PP_NOT_KEYWORD);
+    EXPECT_C_DIALECT_KINDS(LY_TKKEY_C99 | LY_TKKEY_GNU, "bool typeof __attribute__ __auto_type", LY_TK_PP_NOT_KEYWORD, LY_TK_KW_TYPEOF, LY_TK_KW___ATTRIBUTE__, LY_TK_KW___AUTO_TYPE);
+    EXPECT_C_DIALECT_KINDS(LY_TKKEY_C, "restrict inline _Bool", LY_TK_PP_NOT_KEYWORD, LY_TK_PP_NOT_KEYWORD, LY_TK_KW__BOOL);
+    EXPECT_C_DIALECT_KINDS(LY_TKKEY_C | LY_TKKEY_GNU, "restrict inline", LY_TK_PP_NOT_KEYWORD, LY_TK_KW_INLINE);
+
+    // The C dialect has nothing to do with Laye.
+    expect_kinds_at(__LINE__, LY_LEXMODE_LAYE, LY_TKKEY_C99, "bool var", (const ly_token_kind[]){LY_TK_KW_BOOL, LY_TK_KW_VAR, LY_TK_END_OF_FILE});
+
+    // Built-in tables are used where there is one, and everything else is built once and shared by every lexer of the context.
+    test_context test = {0};
+    test_context_init(&test);
+
+    ly_context_set_c_dialect(&test.context, LY_TKKEY_C23);
+    EXPECT(test.context.c_keyword_table == ly_keyword_table_get_builtin(LY_TKKEY_C23));
+
+    ly_context_set_c_dialect(&test.context, LY_TKKEY_C99 | LY_TKKEY_GNU);
+    EXPECT(test.context.c_dialect_keys == (LY_TKKEY_C | LY_TKKEY_C99 | LY_TKKEY_GNU));
+    EXPECT(test.context.c_keyword_table != nullptr);
+
+    ch_source first = {.name = K_SV_CONST("first"), .text = K_SV_CONST("bool")};
+    ch_source second = {.name = K_SV_CONST("second"), .text = K_SV_CONST("typeof")};
+    ly_lexer first_lexer = {0};
+    ly_lexer second_lexer = {0};
+    ly_lexer_init(&first_lexer, &test.context, &first, LY_LEXMODE_C);
+    ly_lexer_init(&second_lexer, &test.context, &second, LY_LEXMODE_C);
+    EXPECT(first_lexer.keyword_table == test.context.c_keyword_table && second_lexer.keyword_table == test.context.c_keyword_table);
+    EXPECT_NEXT_KIND(&first_lexer, LY_TK_PP_NOT_KEYWORD);
+    EXPECT_NEXT_KIND(&second_lexer, LY_TK_KW_TYPEOF);
+
+    test_context_deinit(&test);
+}
+
+///===--------------------------------------===///
+/// Normalization and locations.
+///===--------------------------------------===///
+
+static void test_normalization(void) {
+    test_context test = {0};
+    test_context_init(&test);
+
+    // Text with nothing to normalize is used as it is.
+    ch_source plain = {
+        .name = K_SV_CONST("plain"),
+        .text = K_SV_CONST("a\nb\\c"),
+    };
+
+    ly_normalized_source normalized = {0};
+    ly_source_normalize(&normalized, &test.context, &plain, true);
+    EXPECT(normalized.text.data == plain.text.data && normalized.offsets.count == 0);
+    EXPECT(4 == ly_source_original_offset(&normalized, 4));
+
+    // "a", CRLF, "b", spliced CRLF, "c", spliced LF, "d".
+    ch_source spliced = {
+        .name = K_SV_CONST("spliced"),
+        .text = K_SV_CONST("a\r\nb\\\r\nc\\\nd"),
+    };
+
+    ly_source_normalize(&normalized, &test.context, &spliced, true);
+    EXPECT(normalized.text.count == 5 && 0 == memcmp(normalized.text.data, "a\nbcd", 5));
+    EXPECT(0 == ly_source_original_offset(&normalized, 0));
+    EXPECT(3 == ly_source_original_offset(&normalized, 2));
+    EXPECT(7 == ly_source_original_offset(&normalized, 3));
+    EXPECT(10 == ly_source_original_offset(&normalized, 4));
+    EXPECT(11 == ly_source_original_offset(&normalized, 5));
+
+    // Laye has no line splices, so only the newline is folded.
+    ch_source laye = {
+        .name = K_SV_CONST("laye"),
+        .text = K_SV_CONST("a\r\nb\\\nc"),
+    };
+
+    ly_source_normalize(&normalized, &test.context, &laye, false);
+    EXPECT(normalized.text.count == 6 && 0 == memcmp(normalized.text.data, "a\nb\\\nc", 6));
+    EXPECT(3 == ly_source_original_offset(&normalized, 2));
+    EXPECT(6 == ly_source_original_offset(&normalized, 5));
+
+    EXPECT(test.error_count == 0);
+    test_context_deinit(&test);
+}
+
+static void test_line_column(void) {
+    test_context test = {0};
+    test_context_init(&test);
+
+    // A tab, a two-byte codepoint and a CRLF, with no newline at the very end.
+    ch_source source = {
+        .name = K_SV_CONST("lines"),
+        .text = K_SV_CONST("ab\n\tx\r\n\xC3\xA9z\n\nlast"),
+    };
+
+    isize_t line = 0, column = 0;
+    ch_source_get_line_column(&test.context, &source, 0, &line, &column);
+    EXPECT(line == 1 && column == 1);
+    ch_source_get_line_column(&test.context, &source, 1, &line, &column);
+    EXPECT(line == 1 && column == 2);
+    ch_source_get_line_column(&test.context, &source, 2, &line, &column);
+    EXPECT(line == 1 && column == 3);
+
+    // Tabs advance to the next tab stop.
+    ch_source_get_line_column(&test.context, &source, 3, &line, &column);
+    EXPECT(line == 2 && column == 1);
+    ch_source_get_line_column(&test.context, &source, 4, &line, &column);
+    EXPECT(line == 2 && column == CH_DEFAULT_TAB_WIDTH + 1);
+
+    // Each codepoint is one column, however many bytes it takes.
+    ch_source_get_line_column(&test.context, &source, 7, &line, &column);
+    EXPECT(line == 3 && column == 1);
+    ch_source_get_line_column(&test.context, &source, 9, &line, &column);
+    EXPECT(line == 3 && column == 2);
+
+    ch_source_get_line_column(&test.context, &source, 11, &line, &column);
+    EXPECT(line == 4 && column == 1);
+    ch_source_get_line_column(&test.context, &source, 15, &line, &column);
+    EXPECT(line == 5 && column == 4);
+
+    // The line table is built by the first lookup and reused by the rest.
+    EXPECT(source.line_starts.count == 5);
+
+    test_context_deinit(&test);
+}
+
+///===--------------------------------------===///
+/// Batch and parallel lexing.
+///===--------------------------------------===///
+
+/// A bit of everything the lexer treats specially: directives, comments spanning lines, numbers, splices, CRLFs, non-ASCII identifiers and a keyword only some dialects have.
+static const char mixed_source_text[] =
+    "#define MAX(a, b) ((a) > (b) ? (a) : (b))\n"
+    "/* a comment\r\n * spanning */ int x = 0x1F + .5e+3; // line comment \\\n still comment\n"
+    "const char* s = &x[1], c = s ?: 2.0f; bool b = caf\xC3\xA9 += x->y <<= 2;\r\n"
+    "  #  include <stdio.h>\n"
+    "long lo\\\nng_name = 1'000 ... lo##ng;\n";
+
+/// Fill @c count bytes of @c buffer with copies of @c text, cut off at a newline.
+static isize_t repeat_text(char* buffer, isize_t count, const char* text) {
+    isize_t text_count = k_cast(isize_t) strlen(text);
+    isize_t written = 0;
+    while (written + text_count <= count) {
+        memcpy(buffer + written, text, k_cast(size_t) text_count);
+        written += text_count;
+    }
+
+    return written;
+}
+
+static void test_lex_all_matches_read_pp_token(ly_lexer_mode mode) {
+    test_context test = {0};
+    test_context_init(&test);
+
+    char text[4096];
+    ch_source source = {
+        .name = K_SV_CONST("mixed"),
+        .text = k_sv(text, repeat_text(text, k_cast(isize_t) sizeof(text), mixed_source_text)),
+    };
+
+    ly_tokens per_call = {0};
+    ly_tokens_init(&per_call, &test.context);
+
+    ly_lexer lexer = {0};
+    ly_lexer_init(&lexer, &test.context, &source, mode);
+
+    ly_token token;
+    do {
+        token = ly_lexer_read_pp_token(&lexer);
+        ly_tokens_push(&per_call, &token);
+    } while (token.kind != LY_TK_END_OF_FILE && per_call.count <= source.text.count);
+
+    ly_tokens batch = {0};
+    ly_tokens_init(&batch, &test.context);
+    ly_lexer_lex_all(&source, mode, &batch);
+
+    EXPECT_SAME_TOKENS(&per_call, &batch);
+
+    ly_tokens_deinit(&batch);
+    ly_tokens_deinit(&per_call);
+    test_context_deinit(&test);
+}
+
+static void test_lex_sources_matches_serial(k_thread_pool* pool) {
+    char first_text[8192];
+    char second_text[1024];
+    isize_t first_count = repeat_text(first_text, k_cast(isize_t) sizeof(first_text), mixed_source_text);
+    const char* invalid_line = "int main() { return \xFF 0; }\n";
+    isize_t second_count = repeat_text(second_text, k_cast(isize_t) sizeof(second_text), invalid_line);
+
+    // Every context needs sources of its own, since adding a source to a context gives it locations there.
+    ch_source serial_sources[2] = {
+        {.name = K_SV_CONST("first"), .text = k_sv(first_text, first_count)},
+        {.name = K_SV_CONST("second"), .text = k_sv(second_text, second_count)},
+    };
+
+    ch_source parallel_sources[2] = {
+        {.name = K_SV_CONST("first"), .text = k_sv(first_text, first_count)},
+        {.name = K_SV_CONST("second"), .text = k_sv(second_text, second_count)},
+    };
+
+    // The same source may come up more than once.
+    enum { SOURCE_COUNT = 4 };
+    int source_order[SOURCE_COUNT] = {0, 1, 0, 1};
+
+    test_context serial = {0};
+    test_context_init(&serial);
+    // C17 rather than the default, so the workers get it wrong unless they lex with the context's dialect.
+    ly_context_set_c_dialect(&serial.context, LY_TKKEY_C99);
+
+    ly_tokens serial_tokens[SOURCE_COUNT] = {0};
+    for (int i = 0; i < SOURCE_COUNT; i++) {
+        ly_tokens_init(&serial_tokens[i], &serial.context);
+        ly_lexer_lex_all(&serial_sources[source_order[i]], LY_LEXMODE_C, &serial_tokens[i]);
+    }
+
+    test_context parallel = {0};
+    test_context_init(&parallel);
+    ly_context_set_c_dialect(&parallel.context, LY_TKKEY_C99);
+
+    ch_source* sources[SOURCE_COUNT];
+    for (int i = 0; i < SOURCE_COUNT; i++) {
+        sources[i] = &parallel_sources[source_order[i]];
+    }
+
+    ly_tokens parallel_tokens[SOURCE_COUNT] = {0};
+    ly_lexer_lex_sources(&parallel.context, pool, sources, SOURCE_COUNT, LY_LEXMODE_C, parallel_tokens);
+
+    for (int i = 0; i < SOURCE_COUNT; i++) {
+        EXPECT_SAME_TOKENS(&serial_tokens[i], &parallel_tokens[i]);
+        ly_tokens_deinit(&parallel_tokens[i]);
+        ly_tokens_deinit(&serial_tokens[i]);
+    }
+
+    // Every invalid byte in the second source is reported once, however many times the source is lexed.
+    k_diag_flush(&serial.diag);
+    k_diag_flush(&parallel.diag);
+    EXPECT(serial.error_count == second_count / k_cast(isize_t) strlen(invalid_line));
+    EXPECT(parallel.error_count == serial.error_count);
+    EXPECT(serial.context.intern_table.entries.count == parallel.context.intern_table.entries.count);
+
+    test_context_deinit(&parallel);
+    test_context_deinit(&serial);
+}
+
+static void test_lex_all_parallel_matches_serial(k_thread_pool* pool, ly_lexer_mode mode) {
+    // Big enough to be split between the workers rather than lexed serially.
+    isize_t capacity = 5 << 20;
+    char* text = malloc(k_cast(size_t) capacity);
+    assert(text != nullptr && "Buy more RAM lol");
+    isize_t count = repeat_text(text, capacity, mixed_source_text);
+
+    ch_source serial_source = {.name = K_SV_CONST("big"), .text = k_sv(text, count)};
+    ch_source parallel_source = serial_source;
+
+    test_context serial = {0};
+    test_context_init(&serial);
+    // C17 rather than the default, so the workers get it wrong unless they lex with the context's dialect.
+    ly_context_set_c_dialect(&serial.context, LY_TKKEY_C99);
+    ly_tokens serial_tokens = {0};
+    ly_tokens_init(&serial_tokens, &serial.context);
+    ly_lexer_lex_all(&serial_source, mode, &serial_tokens);
+
+    test_context parallel = {0};
+    test_context_init(&parallel);
+    ly_context_set_c_dialect(&parallel.context, LY_TKKEY_C99);
+    ly_tokens parallel_tokens = {0};
+    ly_tokens_init(&parallel_tokens, &parallel.context);
+    ly_lexer_lex_all_parallel(pool, &parallel_source, mode, &parallel_tokens);
+
+    EXPECT_SAME_TOKENS(&serial_tokens, &parallel_tokens);
+    EXPECT(serial.context.intern_table.entries.count == parallel.context.intern_table.entries.count);
+
+    k_diag_flush(&serial.diag);
+    k_diag_flush(&parallel.diag);
+    EXPECT(serial.error_count == parallel.error_count);
+
+    ly_tokens_deinit(&parallel_tokens);
+    ly_tokens_deinit(&serial_tokens);
+    test_context_deinit(&parallel);
+    test_context_deinit(&serial);
+    free(text);
+}
+
+int main(void) {
+    test_punctuators();
+    test_keywords();
+    test_keyword_lookup();
+    test_keyword_table_across_modes();
+    test_c_dialects();
+    test_normalization();
+    test_line_column();
+
+    test_lex_all_matches_read_pp_token(LY_LEXMODE_C);
+    test_lex_all_matches_read_pp_token(LY_LEXMODE_LAYE);
+
+    k_thread_pool* pool = k_thread_pool_create(4);
+    test_lex_sources_matches_serial(pool);
+    test_lex_all_parallel_matches_serial(pool, LY_LEXMODE_C);
+    test_lex_all_parallel_matches_serial(pool, LY_LEXMODE_LAYE);
+    k_thread_pool_destroy(pool);
+
+    if (failure_count != 0) {
+        fprintf(stderr, "laye_test: %d failed\n", failure_count);
+        return 1;
+    }
+
+    fprintf(stderr, "laye_test: passed\n");
+    return 0;
+}
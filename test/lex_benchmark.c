@@ -0,0 +1,145 @@
+/// Throughput benchmark for the lexer: one token at a time, a whole source at once, and a whole source in parallel.
+/// Built by nob along with everything else; `./nob bench` runs it.
+/// Usage: lex_benchmark [source megabytes] [worker count]
+/// nob builds everything with sanitizers and without optimizations, so compare numbers between runs of the same build rather than reading them as absolutes.
+
+#include <time.h>
+
+#include <choir/core.h>
+#include <laye/core.h>
+
+#define BENCHMARK_RUN_COUNT 3
+
+static double benchmark_now(void) {
+    struct timespec now;
+    timespec_get(&now, TIME_UTC);
+    return k_cast(double) now.tv_sec + k_cast(double) now.tv_nsec / 1e9;
+}
+
+static void benchmark_diag_callback(void* userdata, k_diag_data_group group) {
+    // Diagnostics are dropped; the benchmark source is expected to be clean.
+}
+
+///===--------------------------------------===///
+/// Lexing.
+///===--------------------------------------===///
+
+/// Typical C, repeated until the source is as big as was asked for.
+static const char benchmark_source_text[] =
+    "#define MAX(a, b) ((a) > (b) ? (a) : (b))\n"
+    "/* Sum every element of the array,\n * skipping the negative ones. */\n"
+    "static long sum_positive(const int* values, int count) {\n"
+    "    long total = 0;\n"
+    "    for (int i = 0; i < count; i++) {\n"
+    "        if (values[i] > 0) total += values[i]; // Only the positive ones.\n"
+    "    }\n"
+    "    return MAX(total, 0x7FFFL) * 1.5e+3 >> 2;\n"
+    "}\n\n";
+
+typedef enum benchmark_lex_method {
+    BENCHMARK_LEX_PER_CALL,
+    BENCHMARK_LEX_ALL,
+    BENCHMARK_LEX_ALL_PARALLEL,
+} benchmark_lex_method;
+
+/// Lex @c text once with @c method in a fresh context, returning the seconds taken and the number of tokens.
+static double benchmark_lex_once(k_thread_pool* pool, k_string_view text, benchmark_lex_method method, isize_t* out_token_count) {
+    k_arena string_arena = {0};
+    k_arena_init(&string_arena);
+    k_arena node_arena = {0};
+    k_arena_init(&node_arena);
+    k_arena diag_arena = {0};
+    k_arena_init(&diag_arena);
+
+    k_diag diag = {0};
+    k_diag_init(&diag, &diag_arena, benchmark_diag_callback, nullptr);
+
+    ch_context context = {0};
+    ch_context_init(&context, &diag, &string_arena, &node_arena);
+
+    ch_source source = {
+        .name = K_SV_CONST("benchmark.c"),
+        .text = text,
+    };
+
+    ly_tokens tokens = {0};
+    ly_tokens_init(&tokens, &context);
+
+    double start = benchmark_now();
+    switch (method) {
+        case BENCHMARK_LEX_PER_CALL: {
+            ly_lexer lexer = {0};
+            ly_lexer_init(&lexer, &context, &source, LY_LEXMODE_C);
+
+            ly_token token;
+            do {
+                token = ly_lexer_read_pp_token(&lexer);
+                ly_tokens_push(&tokens, &token);
+            } while (token.kind != LY_TK_END_OF_FILE);
+        } break;
+
+        case BENCHMARK_LEX_ALL: {
+            ly_lexer_lex_all(&source, LY_LEXMODE_C, &tokens);
+        } break;
+
+        case BENCHMARK_LEX_ALL_PARALLEL: {
+            ly_lexer_lex_all_parallel(pool, &source, LY_LEXMODE_C, &tokens);
+        } break;
+    }
+
+    double seconds = benchmark_now() - start;
+    *out_token_count = tokens.count;
+
+    ly_tokens_deinit(&tokens);
+    k_diag_deinit(&diag);
+    k_arena_deinit(&diag_arena);
+    k_arena_deinit(&node_arena);
+    k_arena_deinit(&string_arena);
+    return seconds;
+}
+
+static void benchmark_lexing(k_thread_pool* pool, isize_t source_size) {
+    char* text = malloc(k_cast(size_t) source_size);
+    assert(text != nullptr && "Buy more RAM lol");
+
+    isize_t text_count = 0;
+    isize_t snippet_count = k_cast(isize_t) sizeof(benchmark_source_text) - 1;
+    while (text_count + snippet_count <= source_size) {
+        memcpy(text + text_count, benchmark_source_text, k_cast(size_t) snippet_count);
+        text_count += snippet_count;
+    }
+
+    const char* method_names[] = {
+        [BENCHMARK_LEX_PER_CALL] = "ly_lexer_read_pp_token",
+        [BENCHMARK_LEX_ALL] = "ly_lexer_lex_all",
+        [BENCHMARK_LEX_ALL_PARALLEL] = "ly_lexer_lex_all_parallel",
+    };
+
+    double megabytes = k_cast(double) text_count / (1024.0 * 1024.0);
+    fprintf(stderr, "lexing %.1f MiB, best of %d, %td workers\n", megabytes, BENCHMARK_RUN_COUNT, k_thread_pool_get_worker_count(pool));
+
+    for (int method = BENCHMARK_LEX_PER_CALL; method <= BENCHMARK_LEX_ALL_PARALLEL; method++) {
+        double best_seconds = 0;
+        isize_t token_count = 0;
+        for (int run = 0; run < BENCHMARK_RUN_COUNT; run++) {
+            double seconds = benchmark_lex_once(pool, k_sv(text, text_count), k_cast(benchmark_lex_method) method, &token_count);
+            if (run == 0 || seconds < best_seconds) best_seconds = seconds;
+        }
+
+        fprintf(stderr, "  %-26s %9.1f MiB/s %12td tokens\n", method_names[method], megabytes / best_seconds, token_count);
+    }
+
+    free(text);
+}
+
+int main(int argc, char** argv) {
+    isize_t source_megabytes = argc > 1 ? atoi(argv[1]) : 32;
+    isize_t worker_count = argc > 2 ? atoi(argv[2]) : 4;
+    if (source_megabytes < 1) source_megabytes = 1;
+    if (worker_count < 1) worker_count = 1;
+
+    k_thread_pool* pool = k_thread_pool_create(worker_count);
+    benchmark_lexing(pool, source_megabytes << 20);
+    k_thread_pool_destroy(pool);
+    return 0;
+}